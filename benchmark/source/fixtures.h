@@ -1,6 +1,7 @@
 #pragma once
 
 #include <benchmark/benchmark.h>
+#include <complex>
 #include <cstring>
 #include <fstream>
 #include <omp.h>
@@ -0,0 +1,93 @@
+/*
+ * Microbenchmarks of the partitioning and small sorting kernels.
+ * Vectorized kernels are compiled only for targets supporting them, e.g. with PPQSORT_OPTIMIZE_NATIVE,
+ * otherwise both variants measure the scalar loop.
+ */
+
+#include <ppqsort.h>
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+// one block of the branchless partition, state.range(0) is the number of distinct values
+template <typename T, bool vectorized>
+void BM_populate_block(benchmark::State& state) {
+    constexpr int block_size = ppqsort::parameters::buffer_size;
+    std::mt19937 rng(42);
+    std::vector<T> data(block_size);
+    for (auto& elem : data)
+        elem = static_cast<T>(rng() % static_cast<std::uint64_t>(state.range(0)));
+    T pivot = data[block_size / 2];
+    alignas(ppqsort::parameters::cacheline_size) ppqsort::parameters::buffer_type offsets[block_size];
+    // comparator unknown to the vectorized kernels, so the scalar loop is used
+    const auto scalar_less = [](const T& a, const T& b) { return a < b; };
+
+    for (auto _ : state) {
+        auto it = data.begin();
+        std::ptrdiff_t count = 0;
+        if constexpr (vectorized)
+            ppqsort::impl::populate_block<ppqsort::impl::left>(it, pivot, offsets, count, std::less<T>(), block_size);
+        else
+            ppqsort::impl::populate_block<ppqsort::impl::left>(it, pivot, offsets, count, scalar_less, block_size);
+        benchmark::DoNotOptimize(count);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * block_size);
+    state.counters["simd_width"] = ppqsort::impl::simd::width();
+}
+
+#define populate_block_benchmark(type)                                                                                 \
+BENCHMARK_TEMPLATE(BM_populate_block, type, false)->Name("BM_populate_block_scalar_" #type)->Arg(2)->Arg(1 << 30);    \
+BENCHMARK_TEMPLATE(BM_populate_block, type, true)->Name("BM_populate_block_vectorized_" #type)->Arg(2)->Arg(1 << 30);
+
+populate_block_benchmark(int)
+populate_block_benchmark(float)
+populate_block_benchmark(double)
+populate_block_benchmark(int64_t)
+
+
+// base case of the sequential loop, state.range(0) is the number of elements
+template <typename T, bool vectorized>
+void BM_small_sort(benchmark::State& state) {
+    using iterator = typename std::vector<T>::iterator;
+    const auto size = static_cast<std::ptrdiff_t>(state.range(0));
+    // inputs are sorted in place one after another and refilled when all of them are sorted
+    constexpr std::ptrdiff_t inputs = 1 << 14;
+    std::mt19937 rng(42);
+    std::vector<T> source(static_cast<std::size_t>(inputs * size));
+    for (auto& elem : source)
+        elem = static_cast<T>(rng());
+    std::vector<T> data = source;
+
+    std::ptrdiff_t input = 0;
+    for (auto _ : state) {
+        if (input == inputs) {
+            state.PauseTiming();
+            std::copy(source.begin(), source.end(), data.begin());
+            input = 0;
+            state.ResumeTiming();
+        }
+        const auto first = data.begin() + input++ * size;
+        if constexpr (vectorized && ppqsort::impl::simd::network_enabled<iterator, std::less<T>>)
+            ppqsort::impl::simd::small_sort<iterator, std::less<T>>(first, first + size);
+        else
+            ppqsort::impl::insertion_sort(first, first + size, std::less<T>());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * size);
+    state.counters["simd_width"] = ppqsort::impl::simd::width();
+}
+
+#define small_sort_benchmark(type)                                                                                     \
+BENCHMARK_TEMPLATE(BM_small_sort, type, false)->Name("BM_small_sort_insertion_" #type)->DenseRange(4, 32, 4);     \
+BENCHMARK_TEMPLATE(BM_small_sort, type, true)->Name("BM_small_sort_network_" #type)->DenseRange(4, 32, 4);
+
+small_sort_benchmark(int16_t)
+small_sort_benchmark(int)
+small_sort_benchmark(float)
+small_sort_benchmark(double)
+small_sort_benchmark(int64_t)
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+#include <chrono>
+
+// macros for registering benchmarks, to avoid code duplication
+// Inspired by https://github.com/voronond/MPQsort/blob/master/benchmark/source/mpqsort.cpp
+
+#define str(X) #X
+
+#define register_templated_benchmark(fixture, name, sort_signature, prepare_code)                                      \
+{                                                                                                                      \
+    for (auto _ : state) {                                                                                             \
+        prepare();                                                                                                     \
+        prepare_code;                                                                                                  \
+        auto start = std::chrono::high_resolution_clock::now();                                                        \
+        sort_signature;                                                                                                \
+        auto end = std::chrono::high_resolution_clock::now();                                                          \
+        deallocate();                                                                                                  \
+        auto elapsed_seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end - start);                 \
+        state.SetIterationTime(elapsed_seconds.count());                                                               \
+    }                                                                                                                  \
+}                                                                                                                      \
+BENCHMARK_REGISTER_F(fixture, name)                                                                                    \
+                    ->UseManualTime()                                                                                  \
+                    ->Name(str(name));
+
+#define register_benchmark_default(sort_signature, sort_name, bench_type, type, bench_setup, prepare_code)             \
+BENCHMARK_TEMPLATE_DEFINE_F(bench_type##VectorFixture,                                                                 \
+                            BM_##sort_name##_##bench_type##_##type##_##bench_setup,                                    \
+                            type)(benchmark::State& state)                                                             \
+register_templated_benchmark(bench_type##VectorFixture,                                                                \
+                             BM_##sort_name##_##bench_type##_##type##_##bench_setup, sort_signature, prepare_code)
+
+#define register_benchmark_size(sort_signature, sort_name, bench_type, type, bench_setup, size, prepare_code)          \
+BENCHMARK_TEMPLATE_DEFINE_F(bench_type##VectorFixture,                                                                 \
+                            BM_##sort_name##_##bench_type##_##type##_##bench_setup,                                    \
+                            type, size)(benchmark::State& state)                                                       \
+register_templated_benchmark(bench_type##VectorFixture,                                                                \
+                             BM_##sort_name##_##bench_type##_##type##_##bench_setup, sort_signature, prepare_code)
+
+#define register_benchmark_range(sort_signature, sort_name, bench_type, type, bench_setup, min, max, prepare_code)     \
+BENCHMARK_TEMPLATE_DEFINE_F(bench_type##VectorFixture,                                                                 \
+                            BM_##sort_name##_##bench_type##_##type##_##bench_setup,                                    \
+                            type, ELEMENTS_VECTOR_DEFAULT, min, max)(benchmark::State& state)                          \
+register_templated_benchmark(bench_type##VectorFixture,                                                                \
+                             BM_##sort_name##_##bench_type##_##type##_##bench_setup, sort_signature, prepare_code)
+
+#define register_string_benchmark(sort_signature, sort_name, bench_type, bench_setup, prepended, prepare_code)         \
+BENCHMARK_TEMPLATE_DEFINE_F(bench_type##StringVectorFixture,                                                           \
+                            BM_##sort_name##_##bench_type##_string_##bench_setup,                                      \
+                            prepended)(benchmark::State& state)                                                        \
+register_templated_benchmark(bench_type##StringVectorFixture,                                                          \
+                             BM_##sort_name##_##bench_type##_string_##bench_setup, sort_signature, prepare_code)
+
+#define register_matrix_benchmark(sort_signature, sort_name, bench_type, filename, type, prepare_code)                 \
+BENCHMARK_TEMPLATE_DEFINE_F(bench_type##VectorFixture,                                                                 \
+                            BM_##sort_name##_##bench_type##_##filename,                                                \
+                            filename, type)(benchmark::State& state)                                                   \
+register_templated_benchmark(bench_type##VectorFixture,                                                                \
+                             BM_##sort_name##_##bench_type##_##filename, sort_signature, prepare_code)
+
+// thread counts which are not powers of two, on random data and on data with many duplicates (unbalanced splits)
+// sort_function is called as sort_function(data_, threads)
+#define thread_sweep_benchmark_threads(sort_function, sort_name, threads)                                             \
+register_benchmark_default(sort_function(data_, threads), sort_name, Random, int, threads##_threads, "");              \
+register_benchmark_range(sort_function(data_, threads), sort_name, Random, int, small_range_100_##threads##_threads,  \
+                         0, 99, "");
+
+#define thread_sweep_benchmark(sort_function, sort_name)                                                               \
+thread_sweep_benchmark_threads(sort_function, sort_name, 3)                                                            \
+thread_sweep_benchmark_threads(sort_function, sort_name, 5)                                                            \
+thread_sweep_benchmark_threads(sort_function, sort_name, 6)                                                            \
+thread_sweep_benchmark_threads(sort_function, sort_name, 7)                                                            \
+thread_sweep_benchmark_threads(sort_function, sort_name, 12)
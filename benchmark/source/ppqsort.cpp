@@ -18,63 +18,7 @@
 #include <ips4o.hpp>
 
 #include "fixtures.h"
-
-// macros for registering benchmarks, to avoid code duplication
-// Inspired by https://github.com/voronond/MPQsort/blob/master/benchmark/source/mpqsort.cpp
-
-#define str(X) #X
-
-#define register_templated_benchmark(fixture, name, sort_signature, prepare_code)                                      \
-{                                                                                                                      \
-    for (auto _ : state) {                                                                                             \
-        prepare();                                                                                                     \
-        prepare_code;                                                                                                  \
-        auto start = std::chrono::high_resolution_clock::now();                                                        \
-        sort_signature;                                                                                                \
-        auto end = std::chrono::high_resolution_clock::now();                                                          \
-        deallocate();                                                                                                  \
-        auto elapsed_seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end - start);                 \
-        state.SetIterationTime(elapsed_seconds.count());                                                               \
-    }                                                                                                                  \
-}                                                                                                                      \
-BENCHMARK_REGISTER_F(fixture, name)                                                                                    \
-                    ->UseManualTime()                                                                                  \
-                    ->Name(str(name));
-
-#define register_benchmark_default(sort_signature, sort_name, bench_type, type, bench_setup, prepare_code)             \
-BENCHMARK_TEMPLATE_DEFINE_F(bench_type##VectorFixture,                                                                 \
-                            BM_##sort_name##_##bench_type##_##type##_##bench_setup,                                    \
-                            type)(benchmark::State& state)                                                             \
-register_templated_benchmark(bench_type##VectorFixture,                                                                \
-                             BM_##sort_name##_##bench_type##_##type##_##bench_setup, sort_signature, prepare_code)
-
-#define register_benchmark_size(sort_signature, sort_name, bench_type, type, bench_setup, size, prepare_code)          \
-BENCHMARK_TEMPLATE_DEFINE_F(bench_type##VectorFixture,                                                                 \
-                            BM_##sort_name##_##bench_type##_##type##_##bench_setup,                                    \
-                            type, size)(benchmark::State& state)                                                       \
-register_templated_benchmark(bench_type##VectorFixture,                                                                \
-                             BM_##sort_name##_##bench_type##_##type##_##bench_setup, sort_signature, prepare_code)
-
-#define register_benchmark_range(sort_signature, sort_name, bench_type, type, bench_setup, min, max, prepare_code)     \
-BENCHMARK_TEMPLATE_DEFINE_F(bench_type##VectorFixture,                                                                 \
-                            BM_##sort_name##_##bench_type##_##type##_##bench_setup,                                    \
-                            type, ELEMENTS_VECTOR_DEFAULT, min, max)(benchmark::State& state)                          \
-register_templated_benchmark(bench_type##VectorFixture,                                                                \
-                             BM_##sort_name##_##bench_type##_##type##_##bench_setup, sort_signature, prepare_code)
-
-#define register_string_benchmark(sort_signature, sort_name, bench_type, bench_setup, prepended, prepare_code)         \
-BENCHMARK_TEMPLATE_DEFINE_F(bench_type##StringVectorFixture,                                                           \
-                            BM_##sort_name##_##bench_type##_string_##bench_setup,                                      \
-                            prepended)(benchmark::State& state)                                                        \
-register_templated_benchmark(bench_type##StringVectorFixture,                                                          \
-                             BM_##sort_name##_##bench_type##_string_##bench_setup, sort_signature, prepare_code)
-
-#define register_matrix_benchmark(sort_signature, sort_name, bench_type, filename, type, prepare_code)                 \
-BENCHMARK_TEMPLATE_DEFINE_F(bench_type##VectorFixture,                                                                 \
-                            BM_##sort_name##_##bench_type##_##filename,                                                \
-                            filename, type)(benchmark::State& state)                                                   \
-register_templated_benchmark(bench_type##VectorFixture,                                                                \
-                             BM_##sort_name##_##bench_type##_##filename, sort_signature, prepare_code)
+#include "macros.h"
 
 #define default_benchmark(sort_signature, sort_name, prepare_code)                                 \
 register_benchmark_default(sort_signature, sort_name, Random, short, default, prepare_code);       \
@@ -167,6 +111,11 @@ register_benchmark_size(ppqsort::sort(ppqsort::execution::par, data_.begin(), da
 string_benchmark(ppqsort::sort(ppqsort::execution::par, data_.begin(), data_.end()), ppqsort_par_classic, "")                      \
 string_benchmark(ppqsort::sort(ppqsort::execution::par_force_branchless, data_.begin(), data_.end()), ppqsort_par_branchless, "")
 
+template <typename T>
+void ppqsort_par_threads(std::vector<T> & data, const int threads) {
+    ppqsort::sort(ppqsort::execution::par, data.begin(), data.end(), threads);
+}
+
 // Used during implementation to find best configuration
 //ppqsort_tuning_partition
 //ppqsort_parameters_tuning
@@ -186,4 +135,7 @@ complete_benchmark_set_aq(aqsort::sort(data_.size(), &cmp, &sw), aqsort,
     auto cmp = [&](std::size_t i, std::size_t j) { return data_[i] < data_[j]; }
 );
 complete_benchmark_set(mpqsort::sort(mpqsort::execution::par, data_.begin(), data_.end()), mpqsort_par, "");
-complete_benchmark_set(ips4o::parallel::sort(data_.begin(), data_.end()), ips4o, "");
\ No newline at end of file
+complete_benchmark_set(ips4o::parallel::sort(data_.begin(), data_.end()), ips4o, "");
+
+// splitting of threads between subproblems
+thread_sweep_benchmark(ppqsort_par_threads, ppqsort_par)
@@ -0,0 +1,185 @@
+/*
+ * Benchmarks of the C++ threads parallel backend.
+ * The rest of the benchmarks is linked with OpenMP, so the C++ backend is forced here.
+ * Use only functions from namespace ppqsort::impl::cpp in this file,
+ * ppqsort::sort and ppqsort::impl::par_ppqsort are instantiated with the OpenMP backend elsewhere.
+ */
+
+#define FORCE_CPP
+#include <ppqsort.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "fixtures.h"
+#include "macros.h"
+
+template <typename T>
+void ppqsort_cpp_shared_pool(std::vector<T> & data,
+                             const int threads = static_cast<int>(std::thread::hardware_concurrency())) {
+    const ppqsort::impl::cpp::ThreadPoolLease thread_pool(threads - 1);
+    ppqsort::impl::cpp::par_ppqsort(data.begin(), data.end(), std::less<T>(), threads, thread_pool.get());
+}
+
+template <typename T>
+void ppqsort_cpp_private_pool(std::vector<T> & data) {
+    // creates and joins the threads in every call
+    const int threads = static_cast<int>(std::thread::hardware_concurrency());
+    ppqsort::impl::cpp::ThreadPool<> thread_pool(threads - 1);
+    ppqsort::impl::cpp::par_ppqsort(data.begin(), data.end(), std::less<T>(), threads, thread_pool);
+}
+
+template <typename T>
+void ppqsort_cpp_placed_pool(std::vector<T> & data, const ppqsort::impl::cpp::Placement& placement) {
+    // one pool per placement, threads are pinned only once
+    const int threads = static_cast<int>(std::thread::hardware_concurrency());
+    static std::map<ppqsort::impl::cpp::Placement::Mode, std::unique_ptr<ppqsort::impl::cpp::ThreadPool<>>> pools;
+    auto& pool = pools[placement.mode];
+    if (!pool)
+        pool = std::make_unique<ppqsort::impl::cpp::ThreadPool<>>(threads - 1, ppqsort::impl::cpp::WaitPolicy{},
+                                                                  placement);
+    ppqsort::impl::cpp::par_ppqsort(data.begin(), data.end(), std::less<T>(), threads, *pool);
+}
+
+// latency of repeated calls on medium sized inputs
+#define repeated_calls_benchmark(sort_signature, sort_name)                                                     \
+register_benchmark_size(sort_signature, sort_name, Random, int, repeated_1e5, int(1e5), "");                   \
+register_benchmark_size(sort_signature, sort_name, Random, int, repeated_1e6, int(1e6), "");                   \
+register_benchmark_size(sort_signature, sort_name, Random, int, repeated_1e7, int(1e7), "");
+
+repeated_calls_benchmark(ppqsort_cpp_shared_pool(data_), ppqsort_cpp_shared_pool)
+repeated_calls_benchmark(ppqsort_cpp_private_pool(data_), ppqsort_cpp_private_pool)
+
+// splitting of threads between subproblems
+thread_sweep_benchmark(ppqsort_cpp_shared_pool, ppqsort_cpp)
+
+// pinning of workers on SMT machines
+register_benchmark_size(ppqsort_cpp_placed_pool(data_, ppqsort::impl::cpp::Placement{}),
+                        ppqsort_cpp_unpinned, Random, int, 1e8, int(1e8), "");
+register_benchmark_size(ppqsort_cpp_placed_pool(data_, ppqsort::impl::cpp::Placement::spread()),
+                        ppqsort_cpp_spread, Random, int, 1e8, int(1e8), "");
+register_benchmark_size(ppqsort_cpp_placed_pool(data_, ppqsort::impl::cpp::Placement::compact()),
+                        ppqsort_cpp_compact, Random, int, 1e8, int(1e8), "");
+
+
+// ---- task queues throughput ----
+
+namespace queue_ops {
+    using namespace ppqsort::impl::cpp;
+
+    template <typename T> void owner_push(TaskStack<T>& queue, T item) { queue.push(std::move(item)); }
+    template <typename T> bool owner_pop(TaskStack<T>& queue) { return queue.try_pop().has_value(); }
+    template <typename T> bool thief_take(TaskStack<T>& queue) { return queue.try_pop().has_value(); }
+
+    template <typename T> void owner_push(WorkStealingDeque<T>& queue, T item) { queue.push(item); }
+    template <typename T> bool owner_pop(WorkStealingDeque<T>& queue) { return queue.pop().has_value(); }
+    template <typename T> bool thief_take(WorkStealingDeque<T>& queue) { return queue.steal().has_value(); }
+}
+
+// owner pushes and pops batches of tasks, while state.range(0) thieves are stealing from the same queue
+template <typename Queue>
+void BM_task_queue_throughput(benchmark::State& state) {
+    constexpr int batch = 1024;
+    const auto thieves = static_cast<int>(state.range(0));
+    Queue queue;
+    std::atomic<bool> stop{false};
+    std::atomic<std::int64_t> stolen{0};
+    int task = 0;
+
+    std::vector<std::jthread> threads;
+    for (int i = 0; i < thieves; ++i) {
+        threads.emplace_back([&] {
+            std::int64_t my_stolen = 0;
+            while (!stop.load(std::memory_order_relaxed))
+                my_stolen += queue_ops::thief_take(queue);
+            stolen.fetch_add(my_stolen, std::memory_order_relaxed);
+        });
+    }
+
+    std::int64_t popped = 0;
+    for (auto _ : state) {
+        for (int i = 0; i < batch; ++i)
+            queue_ops::owner_push(queue, &task);
+        for (int i = 0; i < batch; ++i)
+            popped += queue_ops::owner_pop(queue);
+    }
+    stop.store(true, std::memory_order_relaxed);
+    threads.clear();
+    state.SetItemsProcessed(popped + stolen.load());
+}
+BENCHMARK_TEMPLATE(BM_task_queue_throughput, ppqsort::impl::cpp::TaskStack<int*>)
+    ->Name("BM_task_queue_throughput_task_stack")->Arg(0)->Arg(1)->Arg(3)->Arg(7)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_task_queue_throughput, ppqsort::impl::cpp::WorkStealingDeque<int*>)
+    ->Name("BM_task_queue_throughput_work_stealing_deque")->Arg(0)->Arg(1)->Arg(3)->Arg(7)->UseRealTime();
+
+
+// recursive binary tree of tiny tasks, same shape as recursion in par_loop
+void BM_thread_pool_task_tree(benchmark::State& state) {
+    const auto depth = static_cast<int>(state.range(0));
+    ppqsort::impl::cpp::ThreadPool<> pool(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+    std::atomic<std::int64_t> executed{0};
+
+    std::function<void(int)> spawn = [&](const int d) {
+        executed.fetch_add(1, std::memory_order_relaxed);
+        if (d == 0)
+            return;
+        pool.push_task([&spawn, d] { spawn(d - 1); });
+        spawn(d - 1);
+    };
+
+    for (auto _ : state) {
+        pool.run_and_wait([&spawn, depth] { spawn(depth); });
+    }
+    state.SetItemsProcessed(executed.load());
+
+    const auto metrics = pool.metrics();
+    state.counters["spin_hits"] = static_cast<double>(metrics.spin_hits);
+    state.counters["parks"] = static_cast<double>(metrics.parks);
+    state.counters["wakeups"] = static_cast<double>(metrics.wakeups);
+    state.counters["notifications"] = static_cast<double>(metrics.notifications);
+    state.counters["steals"] = static_cast<double>(metrics.steals);
+}
+BENCHMARK(BM_thread_pool_task_tree)->Arg(10)->Arg(16)->UseRealTime();
+
+
+// sort on a pool grouped by NUMA nodes, reports how many tasks were taken across the nodes
+void BM_thread_pool_numa_sort(benchmark::State& state) {
+    using namespace ppqsort::impl::cpp;
+    const int threads = ppqsort::impl::default_threads();
+    const auto placement = state.range(0) ? Placement::numa() : Placement::spread();
+    ThreadPool<> pool(threads - 1, WaitPolicy{}, placement);
+
+    // first touch by the pinned workers spreads the pages over the nodes, later writes do not move them
+    const auto size = static_cast<std::size_t>(state.range(1));
+    const std::unique_ptr<int[]> data(new int[size]);
+    pool.run_and_wait([&] {
+        const std::size_t chunk = size / threads + 1;
+        for (std::size_t start = 0; start < size; start += chunk)
+            pool.push_task([&data, start, end = std::min(start + chunk, size)] {
+                std::fill(data.get() + start, data.get() + end, 0);
+            });
+    });
+
+    std::mt19937 rng(42);
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::generate(data.get(), data.get() + size, [&] { return static_cast<int>(rng()); });
+        pool.reset_metrics();
+        state.ResumeTiming();
+        par_ppqsort(data.get(), data.get() + size, std::less<int>(), threads, pool);
+    }
+
+    const auto metrics = pool.metrics();
+    state.counters["steals"] = static_cast<double>(metrics.steals);
+    state.counters["remote_steals"] = static_cast<double>(metrics.remote_steals);
+    state.counters["remote_ratio"] = metrics.steals ? static_cast<double>(metrics.remote_steals) /
+                                                      static_cast<double>(metrics.steals) : 0.0;
+}
+BENCHMARK(BM_thread_pool_numa_sort)->ArgNames({"numa", "size"})
+    ->Args({0, int(1e8)})->Args({1, int(1e8)})->Unit(benchmark::kMillisecond)->UseRealTime();
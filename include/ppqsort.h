@@ -38,7 +38,8 @@ namespace ppqsort::impl {
        static_assert(execution::_is_same_decay_v<ExecutionPolicy, decltype(execution::seq)> ||
                      execution::_is_same_decay_v<ExecutionPolicy, decltype(execution::par)> ||
                      execution::_is_same_decay_v<ExecutionPolicy, decltype(execution::seq_force_branchless)> ||
-                     execution::_is_same_decay_v<ExecutionPolicy, decltype(execution::par_force_branchless)>,
+                     execution::_is_same_decay_v<ExecutionPolicy, decltype(execution::par_force_branchless)> ||
+                     execution::_is_same_decay_v<ExecutionPolicy, decltype(execution::par_radix)>,
            "Provided ExecutionPolicy is not valid. Use predefined policies from namespace ppqsort::execution.");
        if constexpr (execution::_is_same_decay_v<ExecutionPolicy, decltype(execution::seq)>) {
            seq_ppqsort(std::forward<T>(args)...);
@@ -48,6 +49,8 @@ namespace ppqsort::impl {
            seq_ppqsort<true>(std::forward<T>(args)...);
        } else if constexpr (execution::_is_same_decay_v<ExecutionPolicy, decltype(execution::par_force_branchless)>) {
            par_ppqsort<true>(std::forward<T>(args)...);
+       } else if constexpr (execution::_is_same_decay_v<ExecutionPolicy, decltype(execution::par_radix)>) {
+           par_radix_ppqsort(std::forward<T>(args)...);
        } else {
            throw std::invalid_argument("Unknown execution policy."); // this should never happen
        }
@@ -61,7 +64,7 @@ namespace ppqsort {
    }
 
    /**
-    * @Brief Sorts the elements in the range [begin, end). Will use std::less as comparator and std::thread::hardware_concurrency() as the number of threads.
+    * @Brief Sorts the elements in the range [begin, end). Will use std::less as comparator and all CPUs available to the process as the number of threads.
     * @tparam ExecutionPolicy
     * @tparam RandomIt
     * @param policy Defined execution policy. Use predefined policies from namespace ppqsort::execution.
@@ -2,10 +2,13 @@
 
 #include <algorithm>
 #include <ranges>
+#include <tuple>
+#include <utility>
 
 #include "parameters.h"
 #include "partition.h"
 #include "partition_branchless.h"
+#include "simd.h"
 #include "sorts.h"
 
 namespace ppqsort::impl {
@@ -20,6 +23,42 @@ namespace ppqsort::impl {
     using use_branchless = std::integral_constant<bool, std::is_arithmetic_v<T> &&
                                                         is_default_comparator<std::decay_t<Compare>>::value>;
 
+    /**
+     * @brief Split threads between two subproblems proportionally to their sizes (as in balanced quicksort).
+     *        Each part gets at least one thread and the sum stays the same.
+     * @return Number of threads for the left and for the right part.
+     */
+    template <typename diff_t>
+    inline std::pair<int, int> split_threads(const int threads, const diff_t l_size, const diff_t r_size) {
+        // nothing to split, both parts continue sequentially
+        if (threads < 2)
+            return {threads, threads};
+        const diff_t size = std::max(l_size + r_size, static_cast<diff_t>(1));
+        const diff_t l_threads = (l_size * threads + size / 2) / size;
+        const int l_clamped = static_cast<int>(std::clamp(l_threads, static_cast<diff_t>(1),
+                                                          static_cast<diff_t>(threads - 1)));
+        return {l_clamped, threads - l_clamped};
+    }
+
+    /**
+     * @brief Check evenly spaced samples of the range for keys equal to the pivot in *begin.
+     * @return true if the three-way partition is worth it.
+     */
+    template <typename RandomIt, typename Compare,
+              typename diff_t = typename std::iterator_traits<RandomIt>::difference_type>
+    inline bool many_equal_to_pivot(const RandomIt begin, const diff_t size, Compare comp) {
+        constexpr int samples = parameters::equal_keys_samples;
+        if (size <= samples)
+            return false;
+        const diff_t step = size / samples;
+        int equal = 0;
+        for (int i = 0; i < samples; ++i) {
+            const auto& key = begin[i * step + step / 2];
+            equal += !comp(key, *begin) && !comp(*begin, key);
+        }
+        return equal * parameters::equal_keys_ratio >= samples;
+    }
+
     template <typename RandomIt, typename diff_t = typename std::iterator_traits<RandomIt>::difference_type>
     inline void deterministic_shuffle(RandomIt begin, RandomIt end, const diff_t l_size, const diff_t r_size,
                                        RandomIt pivot_pos, const int insertion_threshold) {
@@ -109,6 +148,10 @@ namespace ppqsort::impl {
             diff_t size = end - begin;
 
             if (size <= insertion_threshold) {
+                if constexpr (branchless && simd::network_enabled<RandomIt, Compare>) {
+                    if (simd::small_sort<RandomIt, Compare>(begin, end))
+                        return;
+                }
                 if (leftmost)
                     insertion_sort(begin, end, comp);
                 else
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <vector>
+
+namespace ppqsort::impl {
+
+    /**
+     * @brief Find, how many elements of the first run are among the first diag elements of the stable merge
+     *        of two sorted runs (merge path). Threads can merge disjoint parts of the output without synchronization.
+     * @return Number of elements from the first run, the rest (diag - result) comes from the second run.
+     */
+    template <typename It, typename Compare, typename diff_t>
+    inline diff_t merge_path_split(const It a, const diff_t a_size, const It b, const diff_t b_size,
+                                   const diff_t diag, Compare comp) {
+        diff_t lo = std::max(static_cast<diff_t>(0), diag - b_size);
+        diff_t hi = std::min(diag, a_size);
+        while (lo < hi) {
+            const diff_t mid = lo + (hi - lo) / 2;
+            // on ties elements of the first run go first
+            if (comp(b[diag - mid - 1], a[mid]))
+                hi = mid;
+            else
+                lo = mid + 1;
+        }
+        return lo;
+    }
+
+    /**
+     * @brief Move the part [out_first, out_last) of the stable merge of sorted runs src[0, mid) and src[mid, size)
+     *        to the same positions in dst. The part takes src[a_first, a_last) from the first run,
+     *        positions are found by merge_path_split.
+     */
+    template <typename SrcIt, typename DstIt, typename Compare, typename diff_t>
+    inline void merge_part(const SrcIt src, const DstIt dst, const diff_t mid,
+                           const diff_t out_first, const diff_t out_last,
+                           const diff_t a_first, const diff_t a_last, Compare comp) {
+        const SrcIt b = src + mid;
+        std::merge(std::make_move_iterator(src + a_first), std::make_move_iterator(src + a_last),
+                   std::make_move_iterator(b + (out_first - a_first)), std::make_move_iterator(b + (out_last - a_last)),
+                   dst + out_first, comp);
+    }
+
+    /**
+     * @brief Layout of the parallel merge sort. Range is divided to 2^rounds runs of the same size,
+     *        in round r pairs of neighbouring runs of width 2^r are merged, each pair by the same number of tasks.
+     *        Every thread gets at least one run and the number of rounds is odd,
+     *        so the runs sorted in the buffer are merged back to the input in the last round.
+     */
+    template <typename diff_t>
+    struct MergeSortPlan {
+        diff_t size;
+        int threads;
+        int rounds;
+        int runs;
+
+        MergeSortPlan(const diff_t size, const int threads) : size(size), threads(threads), rounds(1) {
+            while ((1 << rounds) < threads)
+                ++rounds;
+            rounds |= 1;
+            runs = 1 << rounds;
+        }
+
+        /**
+         * @brief Offset of the first element of the run, run == runs gives the size.
+         */
+        [[nodiscard]] diff_t bound(const int run) const {
+            return size * run / runs;
+        }
+
+        [[nodiscard]] int pairs(const int round) const {
+            return runs >> (round + 1);
+        }
+
+        [[nodiscard]] int parts(const int round) const {
+            return std::max(1, threads / pairs(round));
+        }
+
+        /**
+         * @brief Number of independent merge tasks in the round.
+         */
+        [[nodiscard]] int tasks(const int round) const {
+            return pairs(round) * parts(round);
+        }
+
+        /**
+         * @brief Find where the merge tasks of the round start in the first runs of the pairs.
+         *        All of them must be found before the merges start, because the search reads elements,
+         *        which can be already moved by other tasks.
+         * @return i-th task takes the elements [result[i + pair], result[i + pair + 1]) from the first run of its pair.
+         */
+        template <typename SrcIt, typename Compare>
+        [[nodiscard]] std::vector<diff_t> splits(const SrcIt src, const int round, Compare comp) const {
+            std::vector<diff_t> result;
+            result.reserve(tasks(round) + pairs(round));
+            for (int pair = 0; pair < pairs(round); ++pair) {
+                const auto [first, mid, pair_size] = pair_bounds(round, pair);
+                for (int part = 0; part <= parts(round); ++part)
+                    result.push_back(merge_path_split(src + first, mid, src + first + mid, pair_size - mid,
+                                                      pair_size * part / parts(round), comp));
+            }
+            return result;
+        }
+
+        /**
+         * @brief Run one merge task of the round, from src to the same positions in dst.
+         * @param splits Result of splits(src, round, comp).
+         */
+        template <typename SrcIt, typename DstIt, typename Compare>
+        void merge(const SrcIt src, const DstIt dst, const int round, const int task,
+                   const std::vector<diff_t>& splits, Compare comp) const {
+            const int pair = task / parts(round);
+            const int part = task % parts(round);
+            const auto [first, mid, pair_size] = pair_bounds(round, pair);
+            merge_part(src + first, dst + first, mid,
+                       pair_size * part / parts(round), pair_size * (part + 1) / parts(round),
+                       splits[task + pair], splits[task + pair + 1], comp);
+        }
+
+        private:
+            // offset of the pair, size of its first run and size of the pair
+            [[nodiscard]] std::tuple<diff_t, diff_t, diff_t> pair_bounds(const int round, const int pair) const {
+                const int width = 1 << round;
+                const diff_t first = bound(2 * width * pair);
+                return {first, bound(2 * width * pair + width) - first, bound(2 * width * (pair + 1)) - first};
+            }
+    };
+
+    /**
+     * @brief Uninitialized storage for the parallel merge sort.
+     *        Elements are constructed and destroyed by the sort, the buffer only owns the memory.
+     *        Allocation does not throw, data() is nullptr if there is not enough memory.
+     */
+    template <typename T>
+    class MergeBuffer {
+        public:
+            explicit MergeBuffer(const std::size_t size)
+                : data_(static_cast<T*>(::operator new(size * sizeof(T), std::align_val_t{alignof(T)},
+                                                       std::nothrow))) {}
+
+            MergeBuffer(const MergeBuffer&) = delete;
+            MergeBuffer& operator=(const MergeBuffer&) = delete;
+
+            ~MergeBuffer() {
+                ::operator delete(data_, std::align_val_t{alignof(T)});
+            }
+
+            [[nodiscard]] T* data() const {
+                return data_;
+            }
+
+        private:
+            T* data_;
+    };
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace ppqsort::impl::cpp {
+
+    /**
+     * @var sysfs_cpu_root
+     * @brief Directory with CPU topology in the Linux sysfs.
+     */
+    inline constexpr const char* sysfs_cpu_root = "/sys/devices/system/cpu";
+
+    /**
+     * @brief Placement of the worker threads of the thread pool on CPUs.
+     *        By default, the threads are left to the OS scheduler.
+     * @Note  Pinning is supported only on Linux, on other platforms the placement is ignored.
+     */
+    struct Placement {
+        enum class Mode {
+            // threads are not pinned
+            none,
+            // i-th worker is pinned to cpus[i % cpus.size()]
+            cpu_list,
+            // one worker per physical core first, SMT siblings are used only when all cores are taken
+            spread,
+            // fill SMT siblings of a core before moving to the next core, good for sharing caches
+            compact,
+            // workers are grouped by NUMA nodes, they prefer tasks and memory of their own node
+            numa
+        };
+
+        Mode mode = Mode::none;
+        std::vector<int> cpus{};
+
+        static Placement pinned(std::vector<int> cpus) {
+            return {Mode::cpu_list, std::move(cpus)};
+        }
+
+        static Placement spread() {
+            return {Mode::spread, {}};
+        }
+
+        static Placement compact() {
+            return {Mode::compact, {}};
+        }
+
+        static Placement numa() {
+            return {Mode::numa, {}};
+        }
+    };
+
+    /**
+     * @brief Position of a logical CPU in the machine.
+     */
+    struct CpuInfo {
+        int cpu = 0;
+        // physical core, unique only within the package
+        int core = 0;
+        int package = 0;
+    };
+
+    /**
+     * @brief CPUs, on which the calling thread is allowed to run.
+     * @return Empty vector, if the affinity is not available on this platform.
+     */
+    inline std::vector<int> allowed_cpus() {
+        std::vector<int> cpus;
+        #ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+                if (CPU_ISSET(cpu, &set))
+                    cpus.push_back(cpu);
+        }
+        #endif
+        return cpus;
+    }
+
+    /**
+     * @brief Read the topology of the given CPUs from sysfs.
+     *        CPU without topology information is treated as a separate core.
+     * @param cpus Logical CPUs to look up.
+     * @param sysfs_root Directory with cpuN subdirectories, can be replaced for testing.
+     */
+    inline std::vector<CpuInfo> read_cpu_topology(const std::vector<int>& cpus,
+                                                  const std::string& sysfs_root = sysfs_cpu_root) {
+        const auto read_id = [&](const int cpu, const char* name, int& value) {
+            std::ifstream file(sysfs_root + "/cpu" + std::to_string(cpu) + "/topology/" + name);
+            return static_cast<bool>(file >> value);
+        };
+
+        std::vector<CpuInfo> topology;
+        topology.reserve(cpus.size());
+        for (const int cpu : cpus) {
+            CpuInfo info{cpu, cpu, 0};
+            // unknown CPUs go to a package, which does not collide with real ones
+            if (!read_id(cpu, "core_id", info.core) || !read_id(cpu, "physical_package_id", info.package))
+                info = {cpu, cpu, -1};
+            topology.push_back(info);
+        }
+        return topology;
+    }
+
+    /**
+     * @brief Order of CPUs, in which the workers are pinned.
+     * @param topology Available CPUs.
+     * @param mode Placement::Mode::spread or Placement::Mode::compact, other modes keep the order of CPUs.
+     */
+    inline std::vector<int> placement_order(const std::vector<CpuInfo>& topology, const Placement::Mode mode) {
+        // hardware threads of each physical core, cores and threads are sorted by their ids
+        std::map<std::pair<int, int>, std::vector<int>> cores;
+        for (const auto& info : topology)
+            cores[{info.package, info.core}].push_back(info.cpu);
+        for (auto& [key, threads] : cores)
+            std::sort(threads.begin(), threads.end());
+
+        std::vector<int> order;
+        order.reserve(topology.size());
+        if (mode == Placement::Mode::spread) {
+            // take the i-th hardware thread of every core in each round
+            for (std::size_t round = 0; order.size() < topology.size(); ++round) {
+                for (const auto& [key, threads] : cores)
+                    if (round < threads.size())
+                        order.push_back(threads[round]);
+            }
+        } else if (mode == Placement::Mode::compact) {
+            for (const auto& [key, threads] : cores)
+                order.insert(order.end(), threads.begin(), threads.end());
+        } else {
+            for (const auto& info : topology)
+                order.push_back(info.cpu);
+        }
+        return order;
+    }
+
+    /**
+     * @brief CPUs for the workers according to the placement, i-th worker uses cpus[i % cpus.size()].
+     * @return Empty vector, if the workers should not be pinned.
+     */
+    inline std::vector<int> placement_cpus(const Placement& placement,
+                                           const std::string& sysfs_root = sysfs_cpu_root) {
+        switch (placement.mode) {
+            case Placement::Mode::cpu_list:
+                return placement.cpus;
+            case Placement::Mode::spread:
+            case Placement::Mode::compact:
+                return placement_order(read_cpu_topology(allowed_cpus(), sysfs_root), placement.mode);
+            default:
+                return {};
+        }
+    }
+
+    /**
+     * @brief Pin the calling thread to the CPU.
+     * @return true if the thread was pinned.
+     */
+    inline bool pin_current_thread([[maybe_unused]] const int cpu) {
+        #ifdef __linux__
+        if (cpu < 0 || cpu >= CPU_SETSIZE)
+            return false;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        // pid 0 is the calling thread
+        return sched_setaffinity(0, sizeof(set), &set) == 0;
+        #else
+        return false;
+        #endif
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "../../parameters.h"
+
+namespace ppqsort::impl::cpp {
+
+    /**
+     * @brief Move-only replacement of std::function<void()> for thread pool tasks.
+     *        Callables up to the capacity are stored inside the object, so creating a task does not allocate.
+     *        Bigger callables (e.g. with a huge comparator) are allocated on the heap as a fallback.
+     * @tparam Size Total size of the task object in bytes.
+     */
+    template <std::size_t Size = parameters::task_size>
+    class InplaceTask {
+        public:
+            static constexpr std::size_t capacity = Size - sizeof(void*);
+
+            template <typename F>
+            static constexpr bool fits_inplace = sizeof(F) <= capacity &&
+                                                 alignof(F) <= alignof(std::max_align_t) &&
+                                                 std::is_nothrow_move_constructible_v<F>;
+
+            InplaceTask() noexcept = default;
+
+            template <typename F>
+                requires (!std::is_same_v<std::decay_t<F>, InplaceTask> && std::is_invocable_v<std::decay_t<F>&>)
+            InplaceTask(F&& f) {
+                using callable = std::decay_t<F>;
+                if constexpr (fits_inplace<callable>) {
+                    ::new (static_cast<void*>(storage_)) callable(std::forward<F>(f));
+                    ops_ = &inplace_ops<callable>;
+                } else {
+                    ::new (static_cast<void*>(storage_)) callable*(new callable(std::forward<F>(f)));
+                    ops_ = &heap_ops<callable>;
+                }
+            }
+
+            InplaceTask(InplaceTask&& other) noexcept : ops_(other.ops_) {
+                if (ops_) {
+                    ops_->move(other.storage_, storage_);
+                    other.ops_ = nullptr;
+                }
+            }
+
+            InplaceTask& operator=(InplaceTask&& other) noexcept {
+                if (this != &other) {
+                    reset();
+                    if (other.ops_) {
+                        other.ops_->move(other.storage_, storage_);
+                        ops_ = std::exchange(other.ops_, nullptr);
+                    }
+                }
+                return *this;
+            }
+
+            InplaceTask(const InplaceTask&) = delete;
+            InplaceTask& operator=(const InplaceTask&) = delete;
+
+            ~InplaceTask() {
+                reset();
+            }
+
+            void operator()() {
+                ops_->invoke(storage_);
+            }
+
+            explicit operator bool() const noexcept {
+                return ops_ != nullptr;
+            }
+
+            /**
+             * @brief Destroy the stored callable, the task becomes empty.
+             */
+            void reset() noexcept {
+                if (ops_) {
+                    ops_->destroy(storage_);
+                    ops_ = nullptr;
+                }
+            }
+
+        private:
+            struct Ops {
+                void (*invoke)(void* storage);
+                // move-constructs callable to an empty storage and destroys the source
+                void (*move)(void* from, void* to) noexcept;
+                void (*destroy)(void* storage) noexcept;
+            };
+
+            template <typename F>
+            static constexpr Ops inplace_ops{
+                [](void* storage) { (*std::launder(static_cast<F*>(storage)))(); },
+                [](void* from, void* to) noexcept {
+                    F* source = std::launder(static_cast<F*>(from));
+                    ::new (to) F(std::move(*source));
+                    source->~F();
+                },
+                [](void* storage) noexcept { std::launder(static_cast<F*>(storage))->~F(); }
+            };
+
+            template <typename F>
+            static constexpr Ops heap_ops{
+                [](void* storage) { (**std::launder(static_cast<F**>(storage)))(); },
+                [](void* from, void* to) noexcept { ::new (to) F*(*std::launder(static_cast<F**>(from))); },
+                [](void* storage) noexcept { delete *std::launder(static_cast<F**>(storage)); }
+            };
+
+            alignas(std::max_align_t) std::byte storage_[capacity];
+            const Ops* ops_ = nullptr;
+    };
+}
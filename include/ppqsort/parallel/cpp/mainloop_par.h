@@ -1,28 +1,100 @@
 #pragma once
 
-// Libc++ does not support atomic_ref yet
-// https://en.cppreference.com/w/cpp/compiler_support#C.2B.2B20_library_features
-#ifdef __cpp_lib_atomic_ref
+#include <memory>
+#include <mutex>
+
 #include "partition_branchless_par.h"
 #include "partition_par.h"
-#else
-#include "no_atomic_ref/partition_branchless_par.h"
-#include "no_atomic_ref/partition_par.h"
-#endif
 
+#include "merge_sort_par.h"
 #include "thread_pool.h"
+#include "../parallelism.h"
 #include "../../mainloop.h"
+#include "../../radix.h"
 
 namespace ppqsort::impl {
 
     namespace cpp {
 
-    struct ThreadPools {
-        ThreadPools() = default;
-        explicit ThreadPools(const int threads) : partition(threads), tasks(threads) {}
+    /**
+     * @brief Gives access to the thread pool shared by all parallel sorts.
+     *        Pool is created lazily on the first use and kept alive between calls,
+     *        so repeated sorts do not pay for creating and joining the threads.
+     *        Pool is recreated only when a different number of workers is requested.
+     *        If the shared pool is used by another sort, a private pool is created for this lease.
+     */
+    class ThreadPoolLease {
+        public:
+            ThreadPoolLease(ThreadPoolLease&) = delete;
+
+            explicit ThreadPoolLease(const int workers) : lock_(mutex(), std::try_to_lock) {
+                if (lock_.owns_lock()) {
+                    std::unique_ptr<ThreadPool<>>& shared = instance();
+                    if (!shared || shared->size() != static_cast<std::size_t>(workers)) {
+                        // join old threads first, so we do not oversubscribe
+                        shared.reset();
+                        shared = create(workers);
+                    }
+                    pool_ = shared.get();
+                } else {
+                    private_ = create(workers);
+                    pool_ = private_.get();
+                }
+            }
+
+            ThreadPool<>& get() const {
+                return *pool_;
+            }
+
+            /**
+             * @brief Set how the pools for parallel sorts are created, e.g. pin the workers to physical cores.
+             *        Waits for running sorts, the shared pool is recreated by the next sort.
+             */
+            static void configure(const WaitPolicy policy, Placement placement = {}) {
+                const std::lock_guard lock(mutex());
+                instance().reset();
+                const std::lock_guard config_lock(config_mutex());
+                config() = {policy, std::move(placement)};
+            }
+
+        private:
+            struct Config {
+                WaitPolicy policy;
+                Placement placement;
+            };
 
-        ThreadPool<> partition;
-        ThreadPool<> tasks;
+            static std::unique_ptr<ThreadPool<>> create(const int workers) {
+                // private pools are created without the main mutex, config has its own
+                const Config current = [] {
+                    const std::lock_guard lock(config_mutex());
+                    return config();
+                }();
+                return std::make_unique<ThreadPool<>>(workers, current.policy, current.placement);
+            }
+
+            static std::mutex& mutex() {
+                static std::mutex mtx;
+                return mtx;
+            }
+
+            static std::mutex& config_mutex() {
+                static std::mutex mtx;
+                return mtx;
+            }
+
+            static Config& config() {
+                static Config cfg;
+                return cfg;
+            }
+
+            static std::unique_ptr<ThreadPool<>>& instance() {
+                static std::unique_ptr<ThreadPool<>> pool;
+                return pool;
+            }
+
+            std::unique_lock<std::mutex> lock_;
+            std::unique_ptr<ThreadPool<>> private_;
+            ThreadPool<>* pool_ = nullptr;
     };
 
     template <typename RandomIt, typename Compare>
@@ -34,15 +106,18 @@ namespace ppqsort::impl {
         std::latch threads_done(n_threads);
         std::vector<uint8_t> sorted(n_threads);
         const std::size_t chunk_size = (size + n_threads - 1) / n_threads;
-        for (int id = 0; id < n_threads; ++id) {
-            thread_pool.push_task([begin, size, chunk_size, id, &comp, &sorted, &threads_done] {
-                const std::size_t my_begin = id * chunk_size;
-                const std::size_t my_end = std::min(my_begin + chunk_size + 1, size);
-                sorted[id] = std::is_sorted(begin + my_begin, begin + my_end, comp);
-                threads_done.count_down();
-            });
-        }
-        threads_done.wait();
+        const auto check_chunk = [&](const int id) {
+            const std::size_t my_begin = id * chunk_size;
+            const std::size_t my_end = std::min(my_begin + chunk_size + 1, size);
+            sorted[id] = std::is_sorted(begin + my_begin, begin + my_end, comp);
+            threads_done.count_down();
+        };
+        // calling thread checks the first chunk and then the chunks, which nobody has taken yet
+        const std::int64_t mark = thread_pool.mark();
+        for (int id = 1; id < n_threads; ++id)
+            thread_pool.push_task([&check_chunk, id] { check_chunk(id); });
+        check_chunk(0);
+        thread_pool.help_until(threads_done, mark);
 
         return std::all_of(sorted.begin(), sorted.end(), [](const uint8_t x) { return x; });
     }
@@ -52,7 +127,7 @@ namespace ppqsort::impl {
                   typename diff_t = typename std::iterator_traits<RandomIt>::difference_type>
         inline void par_loop(RandomIt begin, RandomIt end, Compare comp,
                              diff_t bad_allowed, diff_t seq_thr, int threads,
-                             ThreadPools& thread_pools,
+                             ThreadPool<>& thread_pool,
                              bool leftmost = true) {
             constexpr int insertion_threshold = branchless ?
                                               parameters::insertion_threshold_primitive
@@ -68,7 +143,38 @@ namespace ppqsort::impl {
                 // pivot is the same as previous pivot
                 // put same elements to the left, and we do not have to recurse
                 if (!leftmost && !comp(*(begin-1), *begin)) {
-                    begin = partition_to_left(begin, end, comp) + 1;
+                    if (threads < 2)
+                        begin = partition_to_left(begin, end, comp) + 1;
+                    else
+                        begin = (branchless ? partition_left_branchless_par(begin, end, comp, threads, thread_pool)
+                                            : partition_to_left_par(begin, end, comp, threads, thread_pool)) + 1;
+                    continue;
+                }
+
+                // many keys equal to the pivot, gather them in the middle and never touch them again
+                if (threads >= 2 && many_equal_to_pivot(begin, size, comp)) {
+                    const auto [eq_begin, eq_end] = partition_three_way_par<branchless>(begin, end, comp, threads, thread_pool);
+                    const diff_t l_size = eq_begin - begin;
+                    const diff_t r_size = end - eq_end;
+                    // too few equal keys were found and the partition is unbalanced
+                    if ((eq_end - eq_begin) < size / parameters::partition_ratio &&
+                        (l_size < size / parameters::partition_ratio || r_size < size / parameters::partition_ratio) &&
+                        --bad_allowed == 0) {
+                        merge_sort_par<RandomIt, Compare, branchless>(begin, end, comp, threads, thread_pool);
+                        return;
+                    }
+                    int l_threads;
+                    std::tie(l_threads, threads) = split_threads(threads, l_size, r_size);
+                    if (l_size > 0)
+                        thread_pool.push_task([begin, eq_begin, comp, bad_allowed, seq_thr,
+                                               l_threads, &thread_pool, leftmost] {
+                            par_loop<RandomIt, Compare, branchless>(begin, eq_begin, comp, bad_allowed, seq_thr,
+                                                                    l_threads, thread_pool, leftmost);
+                        }, thread_pool.preferred_node(begin, eq_begin));
+                    if (eq_end == end)
+                        return;
+                    leftmost = false;
+                    begin = eq_end;
                     continue;
                 }
 
@@ -77,8 +183,8 @@ namespace ppqsort::impl {
                     part_result = branchless ? partition_right_branchless(begin, end, comp)
                                              : partition_to_right(begin, end, comp);
                 } else {
-                    part_result = branchless ? partition_right_branchless_par(begin, end, comp, threads, thread_pools.partition)
-                                             : partition_to_right_par(begin, end, comp, threads, thread_pools.partition);
+                    part_result = branchless ? partition_right_branchless_par(begin, end, comp, threads, thread_pool)
+                                             : partition_to_right_par(begin, end, comp, threads, thread_pool);
                 }
                 RandomIt pivot_pos = part_result.first;
                 const bool already_partitioned = part_result.second;
@@ -90,9 +196,9 @@ namespace ppqsort::impl {
                     bool left = false;
                     bool right = false;
                     if (l_size > insertion_threshold)
-                        left = is_sorted_par(begin, pivot_pos, comp, l_size, threads, leftmost, thread_pools.partition);
+                        left = is_sorted_par(begin, pivot_pos, comp, l_size, threads, leftmost, thread_pool);
                     if (r_size > insertion_threshold)
-                        right = is_sorted_par(pivot_pos + 1, end, comp, r_size, threads, false, thread_pools.partition);
+                        right = is_sorted_par(pivot_pos + 1, end, comp, r_size, threads, false, thread_pool);
                     if (left && right) {
                         return;
                     } else if (left) {
@@ -108,54 +214,103 @@ namespace ppqsort::impl {
                                          r_size < size / parameters::partition_ratio;
 
                 if (highly_unbalanced) {
-                    // switch to heapsort
+                    // switch to parallel merge sort, it keeps O(n log n) and all the threads busy
                     if (--bad_allowed == 0) {
-                        std::make_heap(begin, end, comp);
-                        std::sort_heap(begin, end, comp);
+                        merge_sort_par<RandomIt, Compare, branchless>(begin, end, comp, threads, thread_pool);
                         return;
                     }
                     // partition unbalanced, shuffle elements
                     deterministic_shuffle(begin, end, l_size, r_size, pivot_pos, insertion_threshold);
                 }
 
-                threads >>= 1;
-                thread_pools.tasks.push_task([begin, pivot_pos, comp, bad_allowed, seq_thr,
-                                              threads, &thread_pools, leftmost] {
+                // threads are split proportionally to sizes and their sum stays the same,
+                // so partitions running at the same time never need more workers than the pool has
+                int l_threads;
+                std::tie(l_threads, threads) = split_threads(threads, l_size, r_size);
+                // with NUMA placement, left part goes to the node holding most of its pages
+                thread_pool.push_task([begin, pivot_pos, comp, bad_allowed, seq_thr,
+                                       l_threads, &thread_pool, leftmost] {
                     par_loop<RandomIt, Compare, branchless>(begin, pivot_pos, comp,
-                                                            bad_allowed, seq_thr, threads, thread_pools, leftmost);
-                });
+                                                            bad_allowed, seq_thr, l_threads, thread_pool, leftmost);
+                }, thread_pool.preferred_node(begin, pivot_pos));
                 leftmost = false;
                 begin = ++pivot_pos;
             }
         }
     }
 
+    namespace cpp {
+        /**
+         * @brief Parallel sort using the provided thread pool. Pool is not stopped and can be reused.
+         *        The calling thread takes part in the sort, so the pool needs only threads - 1 workers.
+         *        Pool must not be used by others during the sort.
+         */
+        template <bool Force_branchless = false,
+                  typename RandomIt,
+                  typename Compare = std::less<typename std::iterator_traits<RandomIt>::value_type>,
+                  bool Branchless = use_branchless<typename std::iterator_traits<RandomIt>::value_type, Compare>::value>
+        void par_ppqsort(RandomIt begin, RandomIt end, Compare comp, int threads, ThreadPool<>& thread_pool) {
+            using diff_t = typename std::iterator_traits<RandomIt>::difference_type;
+            if (begin == end)
+                return;
+            constexpr bool branchless = Force_branchless || Branchless;
+            auto size = end - begin;
+            if ((threads < 2) || (size < parameters::seq_threshold))
+                return seq_loop<RandomIt, Compare, branchless, diff_t>(begin, end, comp, log2<diff_t>(size));
+
+            diff_t seq_thr = (end - begin + 1) / threads / parameters::par_thr_div;
+            seq_thr = std::max(seq_thr, static_cast<diff_t>(branchless ? parameters::insertion_threshold_primitive
+                                                                       : parameters::insertion_threshold));
+            thread_pool.run_and_wait([begin, end, comp, seq_thr, threads, &thread_pool] {
+                par_loop<RandomIt, Compare, branchless, diff_t>(begin, end, comp,
+                          log2<diff_t>(end - begin),
+                          seq_thr, threads, thread_pool);
+            });
+        }
+    }
+
+    namespace cpp {
+        /**
+         * @brief Parallel radix sort using the provided thread pool, see par_ppqsort for the requirements on the pool.
+         *        Falls back to par_ppqsort, if the scratch buffer cannot be allocated.
+         */
+        template <typename RandomIt,
+                  typename Compare = std::less<typename std::iterator_traits<RandomIt>::value_type>>
+        void par_radix_ppqsort(RandomIt begin, RandomIt end, Compare comp, int threads, ThreadPool<>& thread_pool) {
+            bool radix_done = true;
+            thread_pool.run_and_wait([&] {
+                radix_ppqsort(begin, end, comp, threads,
+                              [&thread_pool](const int count, const auto& task) {
+                                  run_parallel(count, task, thread_pool);
+                              },
+                              [&radix_done](const auto&) { radix_done = false; });
+            });
+            // comparison sort runs outside of run_and_wait, it waits for the pool itself
+            if (!radix_done)
+                par_ppqsort(begin, end, radix_fallback_compare<typename std::iterator_traits<RandomIt>::value_type>(comp),
+                            threads, thread_pool);
+        }
+    }
+
     template <bool Force_branchless = false,
              typename RandomIt,
              typename Compare = std::less<typename std::iterator_traits<RandomIt>::value_type>,
              bool Branchless = use_branchless<typename std::iterator_traits<RandomIt>::value_type, Compare>::value>
     void par_ppqsort(RandomIt begin, RandomIt end, Compare comp = Compare(),
-                     int threads = static_cast<int>(std::thread::hardware_concurrency())) {
+                     int threads = default_threads()) {
         using diff_t = typename std::iterator_traits<RandomIt>::difference_type;
         if (begin == end)
             return;
         constexpr bool branchless = Force_branchless || Branchless;
         auto size = end - begin;
+        // do not touch the pools for small inputs
         if ((threads < 2) || (size < parameters::seq_threshold))
             return seq_loop<RandomIt, Compare, branchless, diff_t>(begin, end, comp, log2<diff_t>(size));
 
-        diff_t seq_thr = (end - begin + 1) / threads / parameters::par_thr_div;
-        seq_thr = std::max(seq_thr, static_cast<diff_t>(branchless ? parameters::insertion_threshold_primitive
-                                                                   : parameters::insertion_threshold));
-        cpp::ThreadPools threadpools(threads);
-        threadpools.tasks.push_task([begin, end, comp, seq_thr, threads, &threadpools] {
-            cpp::par_loop<RandomIt, Compare, branchless, diff_t>(begin, end, comp,
-                      log2<diff_t>(end - begin),
-                      seq_thr, threads, threadpools);
-        });
-        // first we need to wait for recursive tasks, then we can destroy partition threads
-        threadpools.tasks.wait_and_stop();
-        threadpools.partition.wait_and_stop();
+        // the calling thread is the last worker
+        const cpp::ThreadPoolLease thread_pool(threads - 1);
+        cpp::par_ppqsort<Force_branchless, RandomIt, Compare, Branchless>(begin, end, comp, threads,
+                                                                          thread_pool.get());
     }
 
     template <bool Force_branchless = false,
@@ -164,4 +319,24 @@ namespace ppqsort::impl {
     void par_ppqsort(RandomIt begin, RandomIt end, int threads) {
         return par_ppqsort<Force_branchless>(begin, end, Compare(), threads);
     }
+
+    /**
+     * @brief Parallel radix sort, entry point of execution::par_radix.
+     *        Small inputs are sorted sequentially without touching the pools.
+     */
+    template <typename RandomIt,
+              typename Compare = std::less<typename std::iterator_traits<RandomIt>::value_type>>
+    void par_radix_ppqsort(RandomIt begin, RandomIt end, Compare comp = Compare(),
+                           int threads = default_threads()) {
+        if ((threads < 2) || (end - begin < parameters::seq_threshold))
+            return seq_radix_ppqsort(begin, end, comp);
+        const cpp::ThreadPoolLease thread_pool(threads - 1);
+        cpp::par_radix_ppqsort(begin, end, comp, threads, thread_pool.get());
+    }
+
+    template <typename RandomIt,
+              typename Compare = std::less<typename std::iterator_traits<RandomIt>::value_type>>
+    void par_radix_ppqsort(RandomIt begin, RandomIt end, int threads) {
+        par_radix_ppqsort(begin, end, Compare(), threads);
+    }
 }
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "affinity.h"
+#include "../../parameters.h"
+
+namespace ppqsort::impl::cpp {
+
+    /**
+     * @var sysfs_node_root
+     * @brief Directory with NUMA nodes in the Linux sysfs.
+     */
+    inline constexpr const char* sysfs_node_root = "/sys/devices/system/node";
+
+    /**
+     * @brief Parse list of CPUs in the Linux format, e.g. "0-3,8,10-11".
+     */
+    inline std::vector<int> parse_cpu_list(const std::string& list) {
+        std::vector<int> cpus;
+        std::stringstream stream(list);
+        for (std::string range; std::getline(stream, range, ',');) {
+            int first, last;
+            char dash;
+            std::stringstream range_stream(range);
+            if (!(range_stream >> first))
+                continue;
+            if (!(range_stream >> dash >> last) || dash != '-')
+                last = first;
+            for (int cpu = first; cpu <= last; ++cpu)
+                cpus.push_back(cpu);
+        }
+        return cpus;
+    }
+
+    /**
+     * @brief NUMA node and its CPUs.
+     */
+    struct NumaNode {
+        int id = 0;
+        std::vector<int> cpus{};
+    };
+
+    /**
+     * @brief Read NUMA nodes with at least one CPU from sysfs, sorted by their ids.
+     * @param sysfs_root Directory with nodeN subdirectories, can be replaced for testing.
+     * @return Empty vector, if the topology is not available.
+     */
+    inline std::vector<NumaNode> read_numa_topology(const std::string& sysfs_root = sysfs_node_root) {
+        std::vector<NumaNode> nodes;
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator(sysfs_root, error)) {
+            const std::string name = entry.path().filename().string();
+            if (name.size() <= 4 || name.compare(0, 4, "node") != 0 ||
+                !std::all_of(name.begin() + 4, name.end(), [](const unsigned char c) { return std::isdigit(c); }))
+                continue;
+            std::ifstream file(entry.path() / "cpulist");
+            std::string list;
+            std::getline(file, list);
+            // memory-only nodes have no CPUs, so no workers can be placed there
+            if (auto cpus = parse_cpu_list(list); !cpus.empty())
+                nodes.push_back({std::stoi(name.substr(4)), std::move(cpus)});
+        }
+        std::sort(nodes.begin(), nodes.end(), [](const NumaNode& a, const NumaNode& b) { return a.id < b.id; });
+        return nodes;
+    }
+
+    /**
+     * @brief CPU and NUMA node of each worker.
+     */
+    struct WorkersLayout {
+        // i-th worker is pinned to cpus[i % cpus.size()], empty if the workers are not pinned
+        std::vector<int> cpus{};
+        // NUMA node of the i-th worker, empty if the workers are not grouped by nodes
+        std::vector<int> nodes{};
+    };
+
+    /**
+     * @brief Distribute workers evenly over NUMA nodes, consecutive workers share a node.
+     *        Within a node, workers are spread over physical cores first.
+     * @param nodes NUMA nodes with CPUs available to the process.
+     * @param workers Number of workers.
+     * @param cpu_root Directory with CPU topology, can be replaced for testing.
+     */
+    inline WorkersLayout numa_layout(const std::vector<NumaNode>& nodes, const std::size_t workers,
+                                     const std::string& cpu_root = sysfs_cpu_root) {
+        WorkersLayout layout;
+        if (nodes.empty())
+            return layout;
+        std::vector<std::vector<int>> orders;
+        orders.reserve(nodes.size());
+        for (const auto& node : nodes)
+            orders.push_back(placement_order(read_cpu_topology(node.cpus, cpu_root), Placement::Mode::spread));
+
+        layout.cpus.reserve(workers);
+        layout.nodes.reserve(workers);
+        std::vector<std::size_t> used(nodes.size(), 0);
+        for (std::size_t i = 0; i < workers; ++i) {
+            const std::size_t node = i * nodes.size() / workers;
+            layout.cpus.push_back(orders[node][used[node]++ % orders[node].size()]);
+            layout.nodes.push_back(nodes[node].id);
+        }
+        return layout;
+    }
+
+    /**
+     * @brief Layout of the workers according to the placement.
+     *        For Placement::Mode::numa, nodes are read from sysfs and restricted to CPUs allowed for the process.
+     */
+    inline WorkersLayout workers_layout(const Placement& placement, const std::size_t workers,
+                                        const std::string& node_root = sysfs_node_root) {
+        if (placement.mode != Placement::Mode::numa)
+            return {placement_cpus(placement), {}};
+
+        const std::vector<int> allowed = allowed_cpus();
+        std::vector<NumaNode> nodes;
+        for (auto& node : read_numa_topology(node_root)) {
+            std::erase_if(node.cpus, [&](const int cpu) {
+                return std::find(allowed.begin(), allowed.end(), cpu) == allowed.end();
+            });
+            if (!node.cpus.empty())
+                nodes.push_back(std::move(node));
+        }
+        // no NUMA information, the whole machine is one node
+        if (nodes.empty() && !allowed.empty())
+            nodes.push_back({0, allowed});
+        return numa_layout(nodes, workers);
+    }
+
+    /**
+     * @brief NUMA node holding most of the sampled pages of the memory range.
+     * @return -1 if it is not known, e.g. the pages were not touched yet or the query is not supported.
+     */
+    inline int memory_node([[maybe_unused]] const void* begin, [[maybe_unused]] const void* end) {
+        #if defined(__linux__) && defined(SYS_move_pages)
+        constexpr int samples = parameters::numa_page_samples;
+        const auto page_size = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+        const auto first = reinterpret_cast<std::uintptr_t>(begin);
+        const auto last = reinterpret_cast<std::uintptr_t>(end);
+        if (last <= first)
+            return -1;
+
+        std::array<void*, samples> pages;
+        std::array<int, samples> status;
+        const std::uintptr_t step = (last - first) / samples;
+        for (int i = 0; i < samples; ++i)
+            pages[i] = reinterpret_cast<void*>((first + i * step) & ~(page_size - 1));
+        // with no target nodes, move_pages only reports the node of each page
+        if (syscall(SYS_move_pages, 0, samples, pages.data(), nullptr, status.data(), 0) != 0)
+            return -1;
+
+        // status is negative for pages without node (e.g. not allocated yet)
+        std::sort(status.begin(), status.end());
+        int best = -1, best_count = 0;
+        for (int i = 0; i < samples;) {
+            int j = i;
+            while (j < samples && status[j] == status[i])
+                ++j;
+            if (status[i] >= 0 && j - i > best_count) {
+                best = status[i];
+                best_count = j - i;
+            }
+            i = j;
+        }
+        return best;
+        #else
+        return -1;
+        #endif
+    }
+}
@@ -1,7 +1,5 @@
 #pragma once
 
-#include <latch>
-
 #include "partition_par.h"
 #include "thread_pool.h"
 #include "../../partition.h"
@@ -12,28 +10,11 @@ namespace ppqsort::impl::cpp {
     template <typename RandomIt, typename Compare,
         typename T = typename std::iterator_traits<RandomIt>::value_type,
         typename diff_t = typename std::iterator_traits<RandomIt>::difference_type>
-    inline void process_blocks_branchless(const RandomIt & g_begin, const Compare & comp,
-                   const diff_t& g_size, std::atomic<diff_t>& g_distance,
-                   diff_t& g_first_offset, diff_t& g_last_offset,
-                   const int & block_size, const T& pivot,
-                   unsigned char& g_already_partitioned,
-                   std::atomic<int>& g_dirty_blocks_left, std::atomic<int>& g_dirty_blocks_right,
-                   std::unique_ptr<std::atomic<bool>[]>& g_reserved_left,
-                   std::unique_ptr<std::atomic<bool>[]>& g_reserved_right,
-                   std::barrier<>& barrier, const int t_my_id, std::latch& part_done) {
-        std::atomic_ref<diff_t> a_g_first_offset(g_first_offset);
-        std::atomic_ref<diff_t> a_g_last_offset(g_last_offset);
-        std::atomic_ref<unsigned char> a_g_already_partitioned(g_already_partitioned);
-
-        // iterators for given block
-        diff_t t_left = (block_size * t_my_id) + 1;
-        diff_t t_right = (g_size-1) - block_size * t_my_id;
-        diff_t t_left_start = t_left;
-
-        // block borders
-        diff_t t_left_end = t_left + block_size - 1;
-        diff_t t_right_start = t_right - block_size + 1;
-        diff_t t_right_end = t_right;
+    inline void process_blocks_branchless(const RandomIt & g_begin, const Compare & comp, const int & block_size,
+                                          const T& pivot, BlockPartitionState<diff_t>& state) {
+        // iterators for given block, no blocks yet
+        diff_t t_left = 1, t_left_start = 1, t_left_end = 0;
+        diff_t t_right = 0, t_right_start = 1, t_right_end = 0;
         bool t_already_partitioned = true;
 
         alignas(parameters::cacheline_size) parameters::buffer_type t_offsets_l[parameters::buffer_size] = {0};
@@ -42,21 +23,12 @@ namespace ppqsort::impl::cpp {
         diff_t t_count_l, t_count_r, t_start_l, t_start_r;
         t_count_l = t_count_r = t_start_l = t_start_r = 0;
 
-        // each thread will do the first two blocks
-        solve_left_block(g_begin, t_left, t_left_start, t_left_end, t_offsets_l, t_count_l, pivot, comp);
-        solve_right_block(g_begin, t_right, t_right_start, t_right_end, t_offsets_r, t_count_r, pivot, comp);
-        diff_t swapped_count = swap_offsets(g_begin + t_left_start, g_begin + t_right_end,
-                                            t_offsets_l + t_start_l, t_offsets_r + t_start_r,
-                                            t_count_l, t_count_r, t_already_partitioned);
-        t_count_l -= swapped_count; t_start_l += swapped_count;
-        t_count_r -= swapped_count; t_start_r += swapped_count;
-
         while (true) {
             // get new blocks if needed or end partitioning
             if (t_count_l == 0) {
                 t_start_l = 0;
                 if (!get_new_block<left>(t_left, t_left_end,
-                                         g_distance, a_g_first_offset, block_size)) {
+                                         state.distance, state.first_offset, block_size)) {
                     break;
                 }
                 solve_left_block(g_begin, t_left, t_left_start, t_left_end,
@@ -66,7 +38,7 @@ namespace ppqsort::impl::cpp {
             if (t_count_r == 0) {
                 t_start_r = 0;
                 if (!get_new_block<right>(t_right, t_right_start,
-                                          g_distance, a_g_last_offset, block_size)) {
+                                          state.distance, state.last_offset, block_size)) {
                     break;
                 }
                 solve_right_block(g_begin, t_right, t_right_start, t_right_end,
@@ -74,24 +46,17 @@ namespace ppqsort::impl::cpp {
             }
 
             // swap elements according to the recorded offsets
-            swapped_count = swap_offsets(g_begin + t_left_start, g_begin + t_right_end,
-                                      t_offsets_l + t_start_l, t_offsets_r + t_start_r,
-                                     t_count_l, t_count_r, t_already_partitioned);
+            const diff_t swapped_count = swap_offsets(g_begin + t_left_start, g_begin + t_right_end,
+                                                      t_offsets_l + t_start_l, t_offsets_r + t_start_r,
+                                                      t_count_l, t_count_r, t_already_partitioned);
             t_count_l -= swapped_count; t_start_l += swapped_count;
             t_count_r -= swapped_count; t_start_r += swapped_count;
         }
 
-        a_g_already_partitioned.fetch_and(t_already_partitioned, std::memory_order_relaxed);
-
-        t_right = t_right_start + t_count_r;
-        t_left = t_left_end - t_count_l;
-        // swap dirty blocks to the middle
-        swap_dirty_blocks(g_begin, t_left, t_right,
-                          t_left_end, t_right_start,
-                          g_dirty_blocks_left, g_dirty_blocks_right,
-                          a_g_first_offset, a_g_last_offset, g_reserved_left, g_reserved_right,
-                          block_size, barrier, t_my_id);
-        part_done.count_down();
+        // blocks with misplaced elements left are handed over to the cleanup
+        state.leave(t_count_l ? std::make_pair(t_left_start, t_left_end + 1) : std::make_pair(diff_t{0}, diff_t{0}),
+                    t_count_r ? std::make_pair(t_right_start, t_right_end + 1) : std::make_pair(diff_t{0}, diff_t{0}),
+                    t_already_partitioned);
     }
 
     template<class RandomIt, class Compare,
@@ -108,34 +73,44 @@ namespace ppqsort::impl::cpp {
             return partition_right_branchless(g_begin, g_end, comp);
 
         const T pivot = std::move(*g_begin);
-        // reserve first blocks for each thread
-        // first blocks will be assigned statically
-        diff_t g_first_offset(1 + block_size * thread_count);
-        diff_t g_last_offset(g_size - 1 - block_size * thread_count);
-        std::atomic<diff_t> g_distance(g_size - 1 - block_size * thread_count * 2);
-
-        // counters for dirty blocks
-        std::atomic<int> g_dirty_blocks_left{};
-        std::atomic<int> g_dirty_blocks_right{};
-
-        std::unique_ptr<std::atomic<bool>[]> g_reserved_left(new std::atomic<bool>[thread_count]{});
-        std::unique_ptr<std::atomic<bool>[]> g_reserved_right(new std::atomic<bool>[thread_count]{});
-        unsigned char g_already_partitioned{1};
-
-        std::barrier<> barrier(thread_count);
-        std::latch part_done(thread_count);
+        return run_block_partition<true>(g_begin, g_end, pivot, comp, thread_count, thread_pool,
+            [&](BlockPartitionState<diff_t>& state) {
+                process_blocks_branchless<RandomIt, Compare>(g_begin, comp, block_size, pivot, state);
+            });
+    }
 
-        for (int i = 0; i < thread_count; ++i) {
-            thread_pool.push_task([g_begin, comp, g_size, &g_distance, &g_first_offset, &g_last_offset,
-                                   block_size, pivot, &g_already_partitioned, &g_dirty_blocks_left,
-                                   &g_dirty_blocks_right, &g_reserved_left, &g_reserved_right, &barrier,
-                                   i, &part_done] {
-                process_blocks_branchless<RandomIt, Compare>(g_begin, comp, g_size, g_distance, g_first_offset,
-                g_last_offset, block_size, pivot, g_already_partitioned, g_dirty_blocks_left,
-                g_dirty_blocks_right,g_reserved_left, g_reserved_right, barrier, i, part_done); });
-        }
+    /**
+     * @brief Parallel branchless partition_to_left, elements equal to the pivot go to the left part.
+     *        Reuses the blocks of partition_right_branchless_par with the inverted comparator.
+     * @return Iterator to pivot
+     */
+    template <typename RandomIt, typename Compare>
+    inline RandomIt partition_left_branchless_par(const RandomIt g_begin, const RandomIt g_end, Compare comp,
+                                                  const int thread_count, ThreadPool<>& thread_pool) {
+        // sequential fallback of partition_right_branchless relies on sentinels, so small inputs are handled here
+        if ((g_end - g_begin) - 1 < 2 * parameters::buffer_size * thread_count)
+            return partition_to_left(g_begin, g_end, comp);
+        return partition_right_branchless_par(g_begin, g_end, inverted_compare<Compare>{comp},
+                                              thread_count, thread_pool).first;
+    }
 
-        part_done.wait();
-        return seq_cleanup<true>(g_begin, pivot, comp, g_first_offset, g_last_offset, g_already_partitioned);
+    /**
+     * @brief Parallel three-way partition, elements less than the pivot go to the left,
+     *        elements equal to the pivot to the middle and greater elements to the right.
+     *        The first pass is the usual partition_right, the second pass splits only its right part.
+     * @return Range of elements equal to the pivot
+     */
+    template <bool branchless, typename RandomIt, typename Compare>
+    inline std::pair<RandomIt, RandomIt> partition_three_way_par(const RandomIt g_begin, const RandomIt g_end,
+                                                                 Compare comp, const int thread_count,
+                                                                 ThreadPool<>& thread_pool) {
+        const RandomIt pivot_pos = branchless
+                                   ? partition_right_branchless_par(g_begin, g_end, comp, thread_count, thread_pool).first
+                                   : partition_to_right_par(g_begin, g_end, comp, thread_count, thread_pool).first;
+        // pivot is at the start of the right part, so it can be partitioned again around the same pivot
+        const RandomIt last_equal = branchless
+                                    ? partition_left_branchless_par(pivot_pos, g_end, comp, thread_count, thread_pool)
+                                    : partition_to_left_par(pivot_pos, g_end, comp, thread_count, thread_pool);
+        return {pivot_pos, last_equal + 1};
     }
 };
@@ -1,7 +1,11 @@
 #pragma once
 
-#include <barrier>
-#include <thread>
+#include <algorithm>
+#include <atomic>
+#include <latch>
+#include <memory>
+#include <utility>
+#include <vector>
 
 #include "thread_pool.h"
 #include "../../partition.h"
@@ -9,9 +13,101 @@
 
 namespace ppqsort::impl::cpp {
 
+    /**
+     * @brief State of a parallel block partition shared by its participants.
+     *        Participants can join late or not at all and leave as soon as they find no new block,
+     *        nobody waits for the others. The last participant leaving closes the partition
+     *        and collects the dirty intervals, participants coming later see it closed and return.
+     *        Tasks hold the state by shared_ptr, so they can start after the partition has returned.
+     */
+    template <typename diff_t>
+    class BlockPartitionState {
+        public:
+            BlockPartitionState(const diff_t size, const int thread_count)
+                : distance(size - 1), first_offset(1), last_offset(size - 1),
+                  // each participant leaves at most one dirty block on each side
+                  dirty_(2 * static_cast<std::size_t>(thread_count)) {}
+
+            /**
+             * @brief Register a participant.
+             * @return false if the partition is already closed.
+             */
+            bool join() {
+                int active = active_.load(std::memory_order_relaxed);
+                do {
+                    if (active == closed)
+                        return false;
+                } while (!active_.compare_exchange_weak(active, active + 1, std::memory_order_acquire,
+                                                        std::memory_order_relaxed));
+                return true;
+            }
+
+            /**
+             * @brief Unregister a participant, which leaves intervals [first, last) of elements it did not process.
+             *        The last participant closes the partition.
+             */
+            void leave(const std::pair<diff_t, diff_t> dirty_left, const std::pair<diff_t, diff_t> dirty_right,
+                       const bool already_partitioned) {
+                for (const auto& interval : {dirty_left, dirty_right})
+                    if (interval.first < interval.second)
+                        dirty_[dirty_count_.fetch_add(1, std::memory_order_relaxed)] = interval;
+                if (!already_partitioned)
+                    already_partitioned_.store(false, std::memory_order_relaxed);
+
+                // release publishes the dirty intervals, the last participant acquires all of them
+                int active = active_.load(std::memory_order_relaxed);
+                while (!active_.compare_exchange_weak(active, active == 1 ? closed : active - 1,
+                                                      std::memory_order_acq_rel, std::memory_order_relaxed));
+                if (active == 1)
+                    close();
+            }
+
+            /**
+             * @brief Latch released, when the partition is closed and dirty() is ready.
+             */
+            std::latch& closed_latch() {
+                return closed_latch_;
+            }
+
+            /**
+             * @brief Sorted dirty intervals, including the unclaimed middle of the range.
+             */
+            [[nodiscard]] const std::vector<std::pair<diff_t, diff_t>>& dirty() const {
+                return dirty_;
+            }
+
+            [[nodiscard]] bool already_partitioned() const {
+                return already_partitioned_.load(std::memory_order_relaxed);
+            }
+
+            // elements [1, first_offset) and (last_offset, size) were claimed by participants
+            alignas(parameters::cacheline_size) std::atomic<diff_t> distance;
+            std::atomic<diff_t> first_offset;
+            std::atomic<diff_t> last_offset;
+
+        private:
+            void close() {
+                dirty_.resize(dirty_count_.load(std::memory_order_relaxed));
+                // blocks, which were not claimed, lie between the claimed ones
+                const diff_t middle_first = first_offset.load(std::memory_order_relaxed);
+                const diff_t middle_last = last_offset.load(std::memory_order_relaxed) + 1;
+                if (middle_first < middle_last)
+                    dirty_.emplace_back(middle_first, middle_last);
+                std::sort(dirty_.begin(), dirty_.end());
+                closed_latch_.count_down();
+            }
+
+            static constexpr int closed = -1;
+            alignas(parameters::cacheline_size) std::atomic<int> active_{0};
+            std::atomic<int> dirty_count_{0};
+            std::atomic<bool> already_partitioned_{true};
+            std::vector<std::pair<diff_t, diff_t>> dirty_;
+            std::latch closed_latch_{1};
+    };
+
     template <side s, typename diff_t>
     inline bool get_new_block(diff_t& t_iter, diff_t& t_block_bound, std::atomic<diff_t>& g_distance,
-                              std::atomic_ref<diff_t>& g_offset, const int& block_size) {
+                              std::atomic<diff_t>& g_offset, const int& block_size) {
         const diff_t t_size = g_distance.fetch_sub(block_size, std::memory_order_relaxed);
         if (t_size < block_size) {
             // last block not aligned, no new blocks available
@@ -29,147 +125,63 @@ namespace ppqsort::impl::cpp {
         return true;
     }
 
-
-    template <side s, typename RandomIt, typename diff_t>
-    inline void swap_blocks(const std::atomic<int>& g_dirty_blocks_side, const RandomIt& g_begin,
-                            const diff_t& t_old, const diff_t& t_block_bound,
-                            std::unique_ptr<std::atomic<bool>[]>& reserved, const int& block_size)
-    {
-        const int t_dirty_blocks = g_dirty_blocks_side.load(std::memory_order_relaxed);
-        diff_t swap_start = -1;
-        for (int i = 0; i < t_dirty_blocks; ++i) {
-            // find clean block in dirty segment
-            bool t_reserve_success = false;
-            if (!reserved[i].load(std::memory_order_relaxed)) {
-                bool expected = false;
-                t_reserve_success = reserved[i].compare_exchange_strong(expected, true,
-                                                                        std::memory_order_relaxed,
-                                                                        std::memory_order_relaxed);
-            }
-            if (t_reserve_success) {
-                if constexpr (s == left)
-                    swap_start = t_old - (i + 1) * block_size;
-                else
-                    swap_start = t_old + i * block_size + 1;
-                break;
-            }
-        }
-        RandomIt block_start, block_end;
-        if constexpr (s == left) {
-            block_start = g_begin + t_block_bound - (block_size - 1);
-            block_end = g_begin + t_block_bound + 1;
-        } else {
-            block_start = g_begin + t_block_bound;
-            block_end = g_begin + t_block_bound + block_size;
-        }
-        // swap our dirty block with found clean block
-        std::swap_ranges(block_start, block_end, g_begin + swap_start);
-    }
-
-
-    template <typename RandomIt, typename diff_t>
-    inline void swap_dirty_blocks(const RandomIt& g_begin, const diff_t & t_left, const diff_t & t_right,
-                                  const diff_t & t_left_end, const diff_t & t_right_start,
-                                  std::atomic<int> & g_dirty_blocks_left, std::atomic<int> & g_dirty_blocks_right,
-                                  std::atomic_ref<diff_t> & a_g_first_offset, std::atomic_ref<diff_t> & a_g_last_offset,
-                                  std::unique_ptr<std::atomic<bool>[]>& g_reserved_left,
-                                  std::unique_ptr<std::atomic<bool>[]>& g_reserved_right,
-                                  const int& block_size, std::barrier<>& barrier,
-                                  const int& t_my_id)
-    {
-        const bool t_dirty_left = t_left <= t_left_end;
-        const bool t_dirty_right = t_right >= t_right_start;
-
-        // count and clean dirty blocks
-        // maximum of dirty blocks is thread count
-        if (t_dirty_left) {
-            g_dirty_blocks_left.fetch_add(1, std::memory_order_relaxed);
-        }
-        if (t_dirty_right) {
-            g_dirty_blocks_right.fetch_add(1, std::memory_order_relaxed);
-        }
-
-        // wait for all threads
-        // synchronize with relationship --> we can use relaxed memory order
-        barrier.arrive_and_wait();
-
-        // create new pointers which will separate clean and dirty blocks
-        const diff_t t_first_old = a_g_first_offset.load(std::memory_order_relaxed);
-        const diff_t t_first_clean = t_first_old - g_dirty_blocks_left.load(std::memory_order_relaxed) * block_size;
-        const diff_t t_last_old = a_g_last_offset.load(std::memory_order_relaxed);
-        const diff_t t_last_clean = t_last_old + g_dirty_blocks_right.load(std::memory_order_relaxed) * block_size;
-
-        // reserve spots for dirty blocks
-        // g_reserved_<side> == 1 is for dirty blocks that will be in the middle
-        if (t_dirty_left && t_left_end >= t_first_clean) {
-            // Block is dirty and in dirty segment --> reserve spot for it
-            g_reserved_left[(t_first_old - (t_left_end + 1)) / block_size].store(true, std::memory_order_relaxed);
-        }
-        if (t_dirty_right && t_right_start <= t_last_clean) {
-            g_reserved_right[(t_right_start - 1 - t_last_old) / block_size].store(true, std::memory_order_relaxed);
-        }
-        // otherwise do not reserve if is block clean and in dirty segment --> will be swapped
-        // by default, blocks are not reserved (g_reserved_<side>[b] = 0)
-
-        // barrier resets itself and can be reused
-        barrier.arrive_and_wait();
-
-        // swap dirty blocks from clean segment to dirty segment
-        if (t_dirty_left && t_left_end < t_first_clean) {
-            // dirty block in clean segment --> find clean block in dirty segment and swap
-            swap_blocks<left>(g_dirty_blocks_left, g_begin,
-                              t_first_old, t_left_end, g_reserved_left, block_size);
-        }
-        if (t_dirty_right && t_right_start > t_last_clean) {
-            swap_blocks<right>(g_dirty_blocks_right, g_begin, t_last_old,
-                    t_right_start, g_reserved_right, block_size);
-        }
-
-        // update global offsets so it separates clean and dirty segment
-        if (t_my_id == 0) {
-            a_g_first_offset.store(t_first_clean, std::memory_order_relaxed);
-            a_g_last_offset.store(t_last_clean, std::memory_order_relaxed);
-        }
+    /**
+     * @brief Run the parallel block partition, process(state) partitions blocks and leaves the state.
+     *        Calling thread joins first, so the partition cannot be closed before it starts.
+     *        Helpers are pushed to the pool and join whenever they get a thread, late ones just return.
+     * @return Cleaned up partition, see par_cleanup.
+     */
+    template <bool branchless, typename RandomIt, typename Compare, typename Process,
+        typename T = typename std::iterator_traits<RandomIt>::value_type,
+        typename diff_t = typename std::iterator_traits<RandomIt>::difference_type>
+    inline std::pair<RandomIt, bool> run_block_partition(const RandomIt g_begin, const RandomIt g_end,
+                                                         const T& pivot, const Compare& comp,
+                                                         const int thread_count, ThreadPool<>& thread_pool,
+                                                         const Process& process) {
+        const auto state = std::make_shared<BlockPartitionState<diff_t>>(g_end - g_begin, thread_count);
+        state->join();
+        // process is referenced only after a successful join, which means the partition is still running
+        // with NUMA placement, helpers are preferably taken from the node holding the range
+        const int node = thread_pool.preferred_node(g_begin, g_end);
+        const std::int64_t mark = thread_pool.mark();
+        for (int i = 1; i < thread_count; ++i)
+            thread_pool.push_task([state, &process] {
+                if (state->join())
+                    process(*state);
+            }, node);
+        process(*state);
+        // helpers not started yet are run by the caller, they join again or return if the partition is closed
+        thread_pool.help_until(state->closed_latch(), mark);
+
+        // dirty intervals are partitioned by the same threads
+        return par_cleanup<branchless>(g_begin, pivot, comp, state->dirty(),
+                                       state->first_offset.load(std::memory_order_relaxed), g_end - g_begin,
+                                       state->already_partitioned(), thread_count,
+                                       [&thread_pool](const int count, const auto& task) {
+                                           run_parallel(count, task, thread_pool);
+                                       });
     }
 
-
-
     template <typename RandomIt, typename Compare,
         typename T = typename std::iterator_traits<RandomIt>::value_type,
         typename diff_t = typename std::iterator_traits<RandomIt>::difference_type>
-    inline void process_blocks(const RandomIt & g_begin, const Compare & comp,
-                               const diff_t& g_size, std::atomic<diff_t>& g_distance,
-                               diff_t& g_first_offset, diff_t& g_last_offset,
-                               const int & block_size, const T& pivot,
-                               unsigned char& g_already_partitioned,
-                               std::atomic<int>& g_dirty_blocks_left, std::atomic<int>& g_dirty_blocks_right,
-                               std::unique_ptr<std::atomic<bool>[]>& g_reserved_left,
-                               std::unique_ptr<std::atomic<bool>[]>& g_reserved_right,
-                               std::barrier<>& barrier, const int t_my_id, std::latch& part_done) {
-        std::atomic_ref<diff_t> a_g_first_offset{g_first_offset};
-        std::atomic_ref<diff_t> a_g_last_offset{g_last_offset};
-        std::atomic_ref<unsigned char> a_g_already_partitioned{g_already_partitioned};
-
-        // each thread will get first two blocks without collisions
-        // iterators for given block
-        diff_t t_left = (block_size * t_my_id) + 1;
-        diff_t t_right = (g_size-1) - block_size * t_my_id;
-
-        // block borders
-        diff_t t_left_end = t_left + block_size - 1;
-        diff_t t_right_start = t_right - block_size + 1;
-
-        unsigned char t_already_partitioned = 1;
+    inline void process_blocks(const RandomIt & g_begin, const Compare & comp, const int & block_size,
+                               const T& pivot, BlockPartitionState<diff_t>& state) {
+        // no blocks yet, iterators are past the block borders
+        diff_t t_left = 1, t_left_end = 0;
+        diff_t t_right = 0, t_right_start = 1;
+
+        bool t_already_partitioned = true;
         while (true) {
             // get new blocks if needed or end partitioning
             if (t_left > t_left_end) {
                 if (!get_new_block<left>(t_left, t_left_end,
-                                         g_distance, a_g_first_offset, block_size))
+                                         state.distance, state.first_offset, block_size))
                     break;
             }
             if (t_right < t_right_start) {
                 if (!get_new_block<right>(t_right, t_right_start,
-                                          g_distance, a_g_last_offset, block_size))
+                                          state.distance, state.last_offset, block_size))
                     break;
             }
 
@@ -188,19 +200,13 @@ namespace ppqsort::impl::cpp {
                 if (t_left > t_left_end || t_right < t_right_start)
                     break;
                 std::iter_swap(g_begin + t_left, g_begin + t_right);
-                t_already_partitioned = 0;
+                t_already_partitioned = false;
                 while (++t_left <= t_left_end && comp(g_begin[t_left], pivot));
                 while (--t_right >= t_right_start && !comp(g_begin[t_right], pivot));
             }
         }
-        a_g_already_partitioned.fetch_and(t_already_partitioned, std::memory_order_relaxed);
-
-        // swaps dirty blocks from clean segment to dirty segment
-        swap_dirty_blocks(g_begin, t_left, t_right, t_left_end, t_right_start,
-                          g_dirty_blocks_left, g_dirty_blocks_right,
-                          a_g_first_offset, a_g_last_offset, g_reserved_left, g_reserved_right,
-                          block_size, barrier, t_my_id);
-        part_done.count_down();
+        // unprocessed rests of the blocks are left for the cleanup
+        state.leave({t_left, t_left_end + 1}, {t_right_start, t_right + 1}, t_already_partitioned);
     }
 
     template <typename RandomIt, typename Compare,
@@ -219,34 +225,24 @@ namespace ppqsort::impl::cpp {
             return partition_to_right(g_begin, g_end, comp);
 
         const T pivot = std::move(*g_begin);
-        // reserve first blocks for each thread
-        // first blocks will be assigned statically
-        diff_t g_first_offset(1 + block_size * thread_count);
-        diff_t g_last_offset(g_size - 1 - block_size * thread_count);
-        std::atomic<diff_t> g_distance(g_size - 1 - block_size * thread_count * 2);
-
-        // counters for dirty blocks
-        std::atomic<int> g_dirty_blocks_left{};
-        std::atomic<int> g_dirty_blocks_right{};
-
-        // helper arrays for cleaning blocks
-        std::unique_ptr<std::atomic<bool>[]> g_reserved_left(new std::atomic<bool>[thread_count]{});
-        std::unique_ptr<std::atomic<bool>[]> g_reserved_right(new std::atomic<bool>[thread_count]{});
-        unsigned char g_already_partitioned{1};
-
-        std::barrier<> barrier(thread_count);
-        std::latch part_done(thread_count);
-        for (int i = 0; i < thread_count; ++i) {
-            thread_pool.push_task([g_begin, comp, g_size, &g_distance, &g_first_offset, &g_last_offset,
-                                   block_size, pivot, &g_already_partitioned, &g_dirty_blocks_left,
-                                   &g_dirty_blocks_right, &g_reserved_left, &g_reserved_right, &barrier,
-                                   i, &part_done] {
-                process_blocks<RandomIt, Compare>(g_begin, comp, g_size, g_distance, g_first_offset,
-                    g_last_offset, block_size, pivot, g_already_partitioned, g_dirty_blocks_left,
-                    g_dirty_blocks_right, g_reserved_left, g_reserved_right, barrier, i, part_done); });
-        }
-        part_done.wait();
+        return run_block_partition<false>(g_begin, g_end, pivot, comp, thread_count, thread_pool,
+            [&](BlockPartitionState<diff_t>& state) {
+                process_blocks<RandomIt, Compare>(g_begin, comp, block_size, pivot, state);
+            });
+    }
 
-        return seq_cleanup<false>(g_begin, pivot, comp, g_first_offset, g_last_offset, g_already_partitioned);
+    /**
+     * @brief Parallel partition_to_left, elements equal to the pivot go to the left part.
+     *        Reuses the blocks of partition_to_right_par with the inverted comparator.
+     * @return Iterator to pivot
+     */
+    template <typename RandomIt, typename Compare>
+    inline RandomIt partition_to_left_par(const RandomIt g_begin, const RandomIt g_end, Compare comp,
+                                          const int thread_count, ThreadPool<>& thread_pool) {
+        // sequential fallback of partition_to_right relies on sentinels, so small inputs are handled here
+        if ((g_end - g_begin) - 1 < 2 * parameters::par_partition_block_size * thread_count)
+            return partition_to_left(g_begin, g_end, comp);
+        return partition_to_right_par(g_begin, g_end, inverted_compare<Compare>{comp},
+                                      thread_count, thread_pool).first;
     }
 }
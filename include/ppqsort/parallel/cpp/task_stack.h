@@ -3,12 +3,14 @@
 #include <vector>
 #include <mutex>
 #include <optional>
-#include <functional>
+#include <utility>
+
+#include "inplace_task.h"
 
 
 namespace ppqsort::impl::cpp {
 
-    template <typename taskType = std::function<void()>>
+    template <typename taskType = InplaceTask<>>
     class TaskStack {
         public:
             TaskStack(TaskStack&) = delete;
@@ -27,7 +29,7 @@ namespace ppqsort::impl::cpp {
             bool try_push(taskType&& task) {
                 const std::unique_lock lock(mutex_, std::try_to_lock);
                 if (!lock.owns_lock()) return false;
-                stack_.emplace_back(task);
+                stack_.emplace_back(std::move(task));
                 return true;
             }
 
@@ -37,7 +39,7 @@ namespace ppqsort::impl::cpp {
              */
             void push(taskType&& task) {
                 std::lock_guard lock(mutex_);
-                stack_.emplace_back(task);
+                stack_.emplace_back(std::move(task));
             }
 
             /**
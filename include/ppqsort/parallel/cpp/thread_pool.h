@@ -1,22 +1,99 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <functional>
+#include <iterator>
+#include <latch>
+#include <map>
+#include <memory>
 #include <mutex>
-#include <queue>
-#include <semaphore>
 #include <thread>
+#include <utility>
+#include <vector>
 
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+#include "affinity.h"
+#include "inplace_task.h"
+#include "numa.h"
 #include "task_stack.h"
+#include "work_stealing_deque.h"
+#include "../parallelism.h"
 #include "../../parameters.h"
 
 namespace ppqsort::impl::cpp {
-    template <typename taskType = std::function<void()>>
+
+    /**
+     * @brief Hint to the CPU, that we are in a spin loop.
+     */
+    inline void cpu_relax() {
+        #if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+        _mm_pause();
+        #elif defined(__aarch64__) || defined(__arm__)
+        asm volatile("yield");
+        #endif
+    }
+
+    /**
+     * @brief How idle workers wait for new tasks.
+     *        Worker firstly spins, then yields its time slice and finally parks in the kernel,
+     *        until a new task wakes it up.
+     */
+    struct WaitPolicy {
+        unsigned int spin_iterations = parameters::pool_spin_iterations;
+        unsigned int yield_iterations = parameters::pool_yield_iterations;
+        // if false, idle workers never sleep, which gives the lowest latency, but keeps the cores busy
+        bool park = true;
+    };
+
+    /**
+     * @brief Counters of the thread pool, for tuning of the wait policy.
+     */
+    struct ThreadPoolMetrics {
+        // new task found while spinning or yielding, without sleeping
+        std::size_t spin_hits = 0;
+        // worker went to sleep
+        std::size_t parks = 0;
+        // worker woke up from sleep
+        std::size_t wakeups = 0;
+        // wake up signals sent by pushes of new tasks, at most one per task
+        std::size_t notifications = 0;
+        // tasks taken from other workers
+        std::size_t steals = 0;
+        // tasks taken from workers on other NUMA nodes, counted only with NUMA placement
+        std::size_t remote_steals = 0;
+    };
+
+    template <typename taskType = InplaceTask<>>
     class ThreadPool {
         public:
             ThreadPool(ThreadPool&) = delete;
 
-            explicit ThreadPool(const std::size_t threads_count = std::thread::hardware_concurrency()) :
-            threads_count_(threads_count), threads_queues_(threads_count) {
+            /**
+             * @param threads_count Number of worker threads. The thread waiting for the pool works as one more worker,
+             *                      so the pool with N - 1 threads keeps N cores busy.
+             * @param policy How idle workers wait for new tasks.
+             * @param placement Pinning of the workers to CPUs. The calling thread is never pinned by the pool.
+             */
+            explicit ThreadPool(const std::size_t threads_count = default_threads(),
+                                const WaitPolicy policy = {}, const Placement& placement = {}) :
+            ThreadPool(threads_count, policy, workers_layout(placement, threads_count)) {}
+
+            /**
+             * @param threads_count Number of worker threads.
+             * @param policy How idle workers wait for new tasks.
+             * @param layout CPUs and NUMA nodes of the workers, e.g. from numa_layout with a custom topology.
+             */
+            ThreadPool(const std::size_t threads_count, const WaitPolicy policy, WorkersLayout layout) :
+            threads_count_(threads_count), participants_(threads_count + 1), policy_(policy),
+            layout_(std::move(layout)), numa_(numa_nodes_count(layout_) > 1),
+            threads_deques_(participants_), threads_queues_(participants_), slot_caches_(participants_),
+            workers_stats_(participants_), steal_orders_(participants_) {
+                build_steal_orders();
                 threads_.reserve(threads_count);
                 for (unsigned int i = 0; i < threads_count; ++i) {
                     threads_.emplace_back([this, i]() { this->worker(i); });
@@ -28,114 +105,518 @@ namespace ppqsort::impl::cpp {
                     wait_and_stop();
             }
 
+            /**
+             * \brief Wait for all tasks to finish. Threads stay alive and the pool can be reused.
+             *        The calling thread executes pending tasks while waiting.
+             *        Must not be called from the workers of this pool.
+             */
+            void wait() {
+                if (const CallerScope caller(*this); caller.joined())
+                    help();
+                else
+                    blocking_wait();
+            }
+
+            /**
+             * \brief Run the task on the calling thread and wait for all tasks to finish.
+             *        The calling thread works as one more worker, tasks pushed from the task
+             *        go to its own lock-free deque and can be stolen by the workers.
+             *        Must not be called from the workers of this pool.
+             */
+            template <typename F>
+            void run_and_wait(F&& task) {
+                if (const CallerScope caller(*this); caller.joined()) {
+                    task();
+                    help();
+                } else {
+                    // other thread is already helping, leave the task to workers
+                    push_task(taskType(std::forward<F>(task)));
+                    blocking_wait();
+                }
+            }
+
+            /**
+             * \brief Position in the deque of the calling worker. Tasks pushed later can be run by help_until.
+             */
+            [[nodiscard]] std::int64_t mark() const {
+                return worker_pool_ == this ? threads_deques_[worker_id_].bottom() : 0;
+            }
+
+            /**
+             * \brief Wait for the latch. Meanwhile, the calling worker runs its own tasks pushed after the mark,
+             *        which were not stolen yet. Older tasks are left for others, so the caller does not get stuck
+             *        in unrelated work.
+             */
+            void help_until(std::latch& done, const std::int64_t mark) {
+                if (worker_pool_ == this) {
+                    auto& deque = threads_deques_[worker_id_];
+                    while (!done.try_wait() && deque.bottom() > mark) {
+                        auto task = deque.pop();
+                        // the rest was stolen
+                        if (!task)
+                            break;
+                        run_task(task.value());
+                    }
+                }
+                done.wait();
+            }
+
             /**
              * \brief Wait for all tasks to finish and stop the threads.
              *        After this call returns, the thread pool is not usable anymore.
              */
             void wait_and_stop() {
-                // the queue can be empty, but any running task can generate new tasks
-                // check if there are any tasks in queue or being executed, if not we can peacefully stop
-                // otherwise, wait for signal
-                // after the last thread is finished, it will signal that all tasks are finished
-                if (total_tasks_.load(std::memory_order_acquire) > 0)
-                        threads_done_semaphore_.acquire();
+                wait();
 
                 // request stops
-                to_stop_.store(true, std::memory_order_release);
+                to_stop_.store(true, std::memory_order_seq_cst);
 
                 // wake all potentially sleeping threads
-                pending_tasks_.store(1, std::memory_order_release);
-                pending_tasks_.notify_all();
+                wake_epoch_.fetch_add(1, std::memory_order_seq_cst);
+                wake_epoch_.notify_all();
 
                 for (auto& thread : threads_)
                     thread.join();
                 stopped = true;
             }
 
-            void push_task(taskType&& task) {
-                // firstly signal, that we will have some tasks
-                total_tasks_.fetch_add(1, std::memory_order_release);
+            /**
+             * \brief Number of worker threads.
+             */
+            [[nodiscard]] std::size_t size() const {
+                return threads_count_;
+            }
 
-                // relaxed is ok, because we do not care about the exact value
-                const std::size_t i = index_.fetch_add(1, std::memory_order_relaxed);
+            /**
+             * \brief CPUs used for pinning of the workers, i-th worker is pinned to cpus[i % cpus.size()].
+             *        Empty if the workers are not pinned.
+             */
+            [[nodiscard]] const std::vector<int>& workers_cpus() const {
+                return layout_.cpus;
+            }
 
-                // try to push without blocking to any queue
-                // if no queue is available, try again for K times, before waiting for lock
-                constexpr unsigned int K = 2;
-                for (std::size_t n = 0; n < threads_count_ * K; ++n) {
-                    if (threads_queues_[(i + n) % threads_count_].try_push(std::forward<taskType>(task))) {
-                        pending_tasks_.fetch_add(1, std::memory_order_release);
-                        pending_tasks_.notify_all();
-                        return;
-                    }
+            /**
+             * \brief NUMA node holding most of the range. Tasks working with the range should be pushed to this node.
+             * \return -1 if the pool does not span more NUMA nodes or the node is not known.
+             */
+            template <typename It>
+            [[nodiscard]] int preferred_node([[maybe_unused]] It begin, [[maybe_unused]] It end) const {
+                if constexpr (std::contiguous_iterator<It>) {
+                    if (numa_ && begin != end)
+                        return memory_node(std::to_address(begin), std::to_address(end));
                 }
+                return -1;
+            }
 
-                // all queues busy, wait for the first one
-                threads_queues_[i % threads_count_].push(std::forward<taskType>(task));
-                pending_tasks_.fetch_add(1, std::memory_order_release);
-                pending_tasks_.notify_all();
+            /**
+             * \brief Sum of counters of all workers. Values are exact only when the pool is idle.
+             */
+            [[nodiscard]] ThreadPoolMetrics metrics() const {
+                ThreadPoolMetrics result;
+                for (const auto& stats : workers_stats_) {
+                    result.spin_hits += stats.spin_hits.load(std::memory_order_relaxed);
+                    result.parks += stats.parks.load(std::memory_order_relaxed);
+                    result.wakeups += stats.wakeups.load(std::memory_order_relaxed);
+                    result.steals += stats.steals.load(std::memory_order_relaxed);
+                    result.remote_steals += stats.remote_steals.load(std::memory_order_relaxed);
+                }
+                result.notifications = notifications_.load(std::memory_order_relaxed);
+                return result;
+            }
+
+            /**
+             * \brief Reset all counters. Must be called only when the pool is idle.
+             */
+            void reset_metrics() {
+                for (auto& stats : workers_stats_) {
+                    stats.spin_hits.store(0, std::memory_order_relaxed);
+                    stats.parks.store(0, std::memory_order_relaxed);
+                    stats.wakeups.store(0, std::memory_order_relaxed);
+                    stats.steals.store(0, std::memory_order_relaxed);
+                    stats.remote_steals.store(0, std::memory_order_relaxed);
+                }
+                notifications_.store(0, std::memory_order_relaxed);
+            }
+
+            /**
+             * \brief Push a new task.
+             * \param node Preferred NUMA node, e.g. from preferred_node. If it is not the node of the calling thread,
+             *             the task is pushed to a worker on that node. Any worker can still steal it.
+             */
+            void push_task(taskType&& task, const int node = -1) {
+                // firstly signal, that we will have some tasks
+                // seq_cst pairs with joining of the caller, so either the caller sees the task or we wake it up
+                total_tasks_.fetch_add(1, std::memory_order_seq_cst);
+
+                if (const std::vector<unsigned int>* workers = remote_node_workers(node)) {
+                    // only the owner can push to a deque, use the locked queue of a worker on that node
+                    threads_queues_[(*workers)[foreign_index_++ % workers->size()]].push(std::move(task));
+                } else if (worker_pool_ == this) {
+                    // called from our worker, push to its own lock-free deque
+                    // the task stays in the cache of the thread which created it, unless others steal it
+                    TaskSlot* slot = acquire_slot(worker_id_);
+                    slot->task = std::move(task);
+                    threads_deques_[worker_id_].push(slot);
+                } else {
+                    push_foreign(std::move(task));
+                }
+                pending_tasks_.fetch_add(1, std::memory_order_seq_cst);
+                wake_one();
+                if (caller_active_.load(std::memory_order_seq_cst))
+                    total_tasks_.notify_all();
             }
 
         private:
             #ifdef GTEST_FLAG
             FRIEND_TEST(testThreadPool, PushBusyQueues);
             FRIEND_TEST(testThreadPool, PopBusyQueues);
+            FRIEND_TEST(testThreadPool, WorkerPushesToOwnDeque);
+            FRIEND_TEST(testThreadPool, RecycleTaskSlots);
+            FRIEND_TEST(testThreadPool, CallerHelps);
+            FRIEND_TEST(testThreadPool, WakeOne);
+            FRIEND_TEST(testThreadPool, NumaStealOrder);
             #endif
 
+            // counters written only by their owner, relaxed loads and stores are enough
+            struct alignas(parameters::cacheline_size) WorkerStats {
+                std::atomic<std::size_t> spin_hits{0};
+                std::atomic<std::size_t> parks{0};
+                std::atomic<std::size_t> wakeups{0};
+                std::atomic<std::size_t> steals{0};
+                std::atomic<std::size_t> remote_steals{0};
+            };
+
+            static void increment(std::atomic<std::size_t>& counter) {
+                counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+
+            // lets the thread waiting for the pool work as the last worker, with its own deque
+            class CallerScope {
+                public:
+                    explicit CallerScope(ThreadPool& pool) : pool_(pool),
+                    joined_(worker_pool_ != &pool && !pool.caller_active_.exchange(true, std::memory_order_seq_cst)) {
+                        if (joined_) {
+                            // the caller can be a worker of another pool
+                            previous_pool_ = std::exchange(worker_pool_, &pool);
+                            previous_id_ = std::exchange(worker_id_, pool.threads_count_);
+                        }
+                    }
+
+                    ~CallerScope() {
+                        if (joined_) {
+                            worker_pool_ = previous_pool_;
+                            worker_id_ = previous_id_;
+                            pool_.caller_active_.store(false, std::memory_order_release);
+                        }
+                    }
+
+                    [[nodiscard]] bool joined() const {
+                        return joined_;
+                    }
+
+                private:
+                    ThreadPool& pool_;
+                    const bool joined_;
+                    ThreadPool* previous_pool_ = nullptr;
+                    unsigned int previous_id_ = 0;
+            };
+
+            void blocking_wait() {
+                // the queue can be empty, but any running task can generate new tasks
+                // total_tasks_ counts tasks in queues and tasks being executed
+                // the thread which finishes the last task will wake us up
+                std::size_t remaining = total_tasks_.load(std::memory_order_acquire);
+                while (remaining > 0) {
+                    total_tasks_.wait(remaining, std::memory_order_acquire);
+                    remaining = total_tasks_.load(std::memory_order_acquire);
+                }
+            }
+
+            void help() {
+                // execute tasks until all of them are finished
+                // sleep only if there is nothing to steal, new tasks and the last finished task wake us up
+                std::size_t remaining = total_tasks_.load(std::memory_order_seq_cst);
+                while (remaining > 0) {
+                    if (!get_next_task(threads_count_) && !spin_for_tasks(threads_count_))
+                        total_tasks_.wait(remaining, std::memory_order_acquire);
+                    remaining = total_tasks_.load(std::memory_order_acquire);
+                }
+            }
+
+            [[nodiscard]] bool has_pending_tasks() const {
+                return pending_tasks_.load(std::memory_order_seq_cst) > 0;
+            }
+
+            /**
+             * \brief Spin and then yield, until there is a pending task.
+             * \return true if there is a pending task, false if the budget was exhausted.
+             */
+            bool spin_for_tasks(const unsigned int id) {
+                // tasks usually come in bursts, so it is cheaper to spin for a while than to sleep in the kernel
+                for (unsigned int i = 0; i < policy_.spin_iterations; ++i) {
+                    if (has_pending_tasks()) {
+                        increment(workers_stats_[id].spin_hits);
+                        return true;
+                    }
+                    cpu_relax();
+                }
+                for (unsigned int i = 0; i < policy_.yield_iterations; ++i) {
+                    if (has_pending_tasks()) {
+                        increment(workers_stats_[id].spin_hits);
+                        return true;
+                    }
+                    std::this_thread::yield();
+                }
+                return false;
+            }
+
+            void park(const unsigned int id) {
+                // the worker announces itself as sleeper and checks for tasks again,
+                // the pusher increments pending tasks and checks for sleepers,
+                // with seq_cst at least one of them sees the other, so no wake up is lost
+                const std::uint32_t epoch = wake_epoch_.load(std::memory_order_seq_cst);
+                sleepers_.fetch_add(1, std::memory_order_seq_cst);
+                if (!has_pending_tasks() && !to_stop_.load(std::memory_order_seq_cst)) {
+                    increment(workers_stats_[id].parks);
+                    wake_epoch_.wait(epoch, std::memory_order_seq_cst);
+                    increment(workers_stats_[id].wakeups);
+                }
+                sleepers_.fetch_sub(1, std::memory_order_seq_cst);
+            }
+
+            void wake_one() {
+                // wake only one sleeping worker per task, nobody is woken if all of them are spinning or working
+                if (sleepers_.load(std::memory_order_seq_cst) == 0)
+                    return;
+                notifications_.fetch_add(1, std::memory_order_relaxed);
+                wake_epoch_.fetch_add(1, std::memory_order_seq_cst);
+                wake_epoch_.notify_one();
+            }
+
+            // deques hold pointers to slots, slots are recycled, so pushing a task does not allocate
+            struct TaskSlot {
+                taskType task;
+                TaskSlot* next = nullptr;
+                unsigned int owner = 0;
+            };
+
+            struct alignas(parameters::cacheline_size) SlotCache {
+                // all slots created by the worker, accessed only by the owner
+                std::vector<std::unique_ptr<TaskSlot>> slots;
+                // free slots, accessed only by the owner
+                TaskSlot* free = nullptr;
+                // slots released by other threads
+                std::atomic<TaskSlot*> returned{nullptr};
+            };
+
+            TaskSlot* acquire_slot(const unsigned int id) {
+                SlotCache& cache = slot_caches_[id];
+                if (!cache.free)
+                    cache.free = cache.returned.exchange(nullptr, std::memory_order_acquire);
+                if (!cache.free) {
+                    // first use or more tasks in flight than ever before
+                    cache.slots.push_back(std::make_unique<TaskSlot>());
+                    cache.slots.back()->owner = id;
+                    return cache.slots.back().get();
+                }
+                TaskSlot* slot = cache.free;
+                cache.free = slot->next;
+                return slot;
+            }
+
+            void release_slot(TaskSlot* slot) {
+                SlotCache& cache = slot_caches_[slot->owner];
+                if (worker_pool_ == this && worker_id_ == slot->owner) {
+                    slot->next = cache.free;
+                    cache.free = slot;
+                    return;
+                }
+                // return stolen slot to its owner, owner takes all returned slots at once, so there is no ABA
+                TaskSlot* head = cache.returned.load(std::memory_order_relaxed);
+                do {
+                    slot->next = head;
+                } while (!cache.returned.compare_exchange_weak(head, slot, std::memory_order_release,
+                                                                std::memory_order_relaxed));
+            }
+
+            void push_foreign(taskType&& task) {
+                // deques can be pushed only by their owners
+                // tasks from other threads are pushed to queues guarded by mutex
+                // each pushing thread rotates over queues on its own, so there is no shared counter
+                const std::size_t i = foreign_index_++;
+
+                // try to push without blocking to any queue
+                // if no queue is available, try again for K times, before waiting for lock
+                constexpr unsigned int K = 2;
+                for (std::size_t n = 0; n < participants_ * K; ++n) {
+                    if (threads_queues_[(i + n) % participants_].try_push(std::forward<taskType>(task)))
+                        return;
+                }
+
+                // all queues busy, wait for the first one
+                threads_queues_[i % participants_].push(std::forward<taskType>(task));
+            }
+
             bool get_next_task(const unsigned int id) {
-                bool found = false;
+                // firstly, process my own tasks in LIFO order
+                if (auto task = threads_deques_[id].pop()) {
+                    run_task(task.value());
+                    return true;
+                }
+                if (auto task = threads_queues_[id].try_pop()) {
+                    run_task(std::forward<taskType>(task.value()));
+                    return true;
+                }
 
-                // spin around all queues to find a task, start with my queue
-                for (std::size_t n = 0; n < threads_count_; ++n) {
-                    if (auto task = threads_queues_[(id + n) % threads_count_].try_pop()) {
+                // spin around other threads to steal a task (the oldest one), nearest ids first
+                // with NUMA placement, workers on the same node are visited first
+                for (const unsigned int victim : steal_orders_[id]) {
+                    if (auto task = threads_deques_[victim].steal()) {
+                        count_steal(id, victim);
+                        run_task(task.value());
+                        return true;
+                    }
+                    if (auto task = threads_queues_[victim].try_pop()) {
+                        count_steal(id, victim);
                         run_task(std::forward<taskType>(task.value()));
-                        found = true;
-                        break;
+                        return true;
                     }
                 }
 
                 // if all queues busy or empty, check our queue if empty
-                if (!found) {
-                    if (auto task = threads_queues_[id].pop()) {
-                        run_task(std::forward<taskType>(task.value()));
-                        found = true;
+                if (auto task = threads_queues_[id].pop()) {
+                    run_task(std::forward<taskType>(task.value()));
+                    return true;
+                }
+                return false;
+            }
+
+            void count_steal(const unsigned int id, const unsigned int victim) {
+                increment(workers_stats_[id].steals);
+                if (numa_ && node_of(id) != node_of(victim))
+                    increment(workers_stats_[id].remote_steals);
+            }
+
+            // NUMA node of the participant, the caller is not pinned and its node is not known
+            [[nodiscard]] int node_of(const unsigned int id) const {
+                return id < layout_.nodes.size() ? layout_.nodes[id] : -1;
+            }
+
+            static std::size_t numa_nodes_count(const WorkersLayout& layout) {
+                std::vector<int> nodes(layout.nodes);
+                std::sort(nodes.begin(), nodes.end());
+                return static_cast<std::size_t>(std::unique(nodes.begin(), nodes.end()) - nodes.begin());
+            }
+
+            void build_steal_orders() {
+                for (unsigned int id = 0; id < participants_; ++id) {
+                    auto& order = steal_orders_[id];
+                    for (unsigned int n = 1; n < participants_; ++n)
+                        order.push_back((id + n) % participants_);
+                    if (numa_ && node_of(id) >= 0) {
+                        std::stable_partition(order.begin(), order.end(),
+                                              [&](const unsigned int victim) { return node_of(victim) == node_of(id); });
                     }
                 }
+                if (numa_) {
+                    for (unsigned int id = 0; id < threads_count_; ++id)
+                        node_workers_[node_of(id)].push_back(id);
+                }
+            }
 
-                return found;
+            // workers of the node, if the task should go there, nullptr if it can stay on the current thread
+            const std::vector<unsigned int>* remote_node_workers(const int node) const {
+                if (!numa_ || node < 0 || (worker_pool_ == this && node_of(worker_id_) == node))
+                    return nullptr;
+                const auto it = node_workers_.find(node);
+                return it != node_workers_.end() ? &it->second : nullptr;
+            }
+
+            void run_task(TaskSlot* slot) {
+                pending_tasks_.fetch_sub(1, std::memory_order_release);
+                slot->task();
+                // destroy captures and recycle the slot before signalling the end of the task
+                slot->task = taskType();
+                release_slot(slot);
+                finish_task();
             }
 
             void run_task(taskType&& task) {
                 pending_tasks_.fetch_sub(1, std::memory_order_release);
                 task();
-                total_tasks_.fetch_sub(1, std::memory_order_release);
+                finish_task();
             }
 
-            void worker(const unsigned int id) {
-                while (true) {
-                    // sleep until there are any tasks in queues
-                    pending_tasks_.wait(0, std::memory_order_acquire);
-                    if (to_stop_.load(std::memory_order_acquire))
-                        break;
+            void finish_task() {
+                // last task finished --> wake up threads waiting for the pool
+                if (total_tasks_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    total_tasks_.notify_all();
+            }
 
+            void worker(const unsigned int id) {
+                if (!layout_.cpus.empty())
+                    pin_current_thread(layout_.cpus[id % layout_.cpus.size()]);
+                worker_pool_ = this;
+                worker_id_ = id;
+                while (!to_stop_.load(std::memory_order_acquire)) {
                     // while there are tasks, execute them (mine or stolen)
                     while (get_next_task(id));
 
-                    // no tasks are in queues or handled --> signal that our work is done
-                    if (total_tasks_.load(std::memory_order_acquire) == 0)
-                        threads_done_semaphore_.release();
+                    // wait for new tasks
+                    if (!spin_for_tasks(id) && policy_.park)
+                        park(id);
                 }
+                worker_pool_ = nullptr;
             }
 
+            // identification of the pool and worker, which is running on the current thread
+            static inline thread_local ThreadPool* worker_pool_ = nullptr;
+            static inline thread_local unsigned int worker_id_ = 0;
+            // start of the search for a free queue, when pushing from other threads
+            static inline thread_local std::size_t foreign_index_ =
+                std::hash<std::thread::id>{}(std::this_thread::get_id());
+
             const unsigned int threads_count_;
+            // workers and the waiting caller
+            const unsigned int participants_;
+            const WaitPolicy policy_;
+            const WorkersLayout layout_;
+            // workers span more NUMA nodes
+            const bool numa_;
             std::vector<std::thread> threads_;
-            std::vector<TaskStack<>> threads_queues_;
-            alignas(parameters::cacheline_size) std::atomic<std::size_t> index_{0};
+            std::vector<WorkStealingDeque<TaskSlot*>> threads_deques_;
+            std::vector<TaskStack<taskType>> threads_queues_;
+            std::vector<SlotCache> slot_caches_;
+            std::vector<WorkerStats> workers_stats_;
+            // victims for stealing of each participant, nearest first
+            std::vector<std::vector<unsigned int>> steal_orders_;
+            std::map<int, std::vector<unsigned int>> node_workers_;
             alignas(parameters::cacheline_size) std::atomic<std::size_t> pending_tasks_{0};
             alignas(parameters::cacheline_size) std::atomic<std::size_t> total_tasks_{0};
+            alignas(parameters::cacheline_size) std::atomic<std::uint32_t> wake_epoch_{0};
+            std::atomic<unsigned int> sleepers_{0};
+            std::atomic<std::size_t> notifications_{0};
             alignas(parameters::cacheline_size) std::atomic<bool> to_stop_{false};
-            std::binary_semaphore threads_done_semaphore_{0};   // used to wait for all tasks to finish
-            std::mutex mtx_priority_;
+            std::atomic<bool> caller_active_{false};
             bool stopped = false;
     };
-}
\ No newline at end of file
+
+    /**
+     * @brief Run task(0), ..., task(count - 1) in the thread pool.
+     *        The calling thread runs the first task and then helps, until all tasks are done.
+     *        It is meant for tasks of the pool, other callers only wait for the workers.
+     */
+    template <typename Task>
+    inline void run_parallel(const int count, const Task& task, ThreadPool<>& thread_pool) {
+        std::latch done(count);
+        const std::int64_t mark = thread_pool.mark();
+        for (int i = 1; i < count; ++i)
+            thread_pool.push_task([&task, &done, i] {
+                task(i);
+                done.count_down();
+            });
+        task(0);
+        done.count_down();
+        thread_pool.help_until(done, mark);
+    }
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+#include "../../parameters.h"
+
+namespace ppqsort::impl::cpp {
+
+    /**
+     * @brief Lock-free work-stealing deque (Chase-Lev).
+     *        Only the owner thread can push and pop (LIFO) on the bottom end,
+     *        any other thread can steal (FIFO) from the top end.
+     * @Note  Implementation follows "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al., 2013).
+     *        Elements are loaded by thieves before they are claimed, therefore they must be trivially copyable
+     *        (e.g. pointers to tasks).
+     * @tparam T Type of the stored elements.
+     */
+    template <typename T>
+    class WorkStealingDeque {
+        static_assert(std::is_trivially_copyable_v<T>, "Stored elements must be trivially copyable");
+
+        using index_t = std::int64_t;
+
+        class RingBuffer {
+            public:
+                explicit RingBuffer(const index_t capacity) :
+                capacity_(capacity), mask_(capacity - 1), data_(new std::atomic<T>[capacity]) {}
+
+                [[nodiscard]] index_t capacity() const {
+                    return capacity_;
+                }
+
+                // release/acquire on elements is free on x86 and makes the publication visible to tools like TSan
+                void put(const index_t i, T item) {
+                    data_[i & mask_].store(item, std::memory_order_release);
+                }
+
+                T get(const index_t i) const {
+                    return data_[i & mask_].load(std::memory_order_acquire);
+                }
+
+                RingBuffer* grow(const index_t bottom, const index_t top) const {
+                    auto* bigger = new RingBuffer(capacity_ * 2);
+                    for (index_t i = top; i != bottom; ++i)
+                        bigger->put(i, get(i));
+                    return bigger;
+                }
+
+            private:
+                const index_t capacity_;
+                const index_t mask_;
+                std::unique_ptr<std::atomic<T>[]> data_;
+        };
+
+        public:
+            WorkStealingDeque(WorkStealingDeque&) = delete;
+
+            /**
+             * @param capacity Initial capacity, rounded up to power of two.
+             */
+            explicit WorkStealingDeque(const index_t capacity = 128) {
+                index_t rounded = 1;
+                while (rounded < capacity)
+                    rounded <<= 1;
+                buffers_.emplace_back(new RingBuffer(rounded));
+                buffer_.store(buffers_.back().get(), std::memory_order_relaxed);
+            }
+
+            /**
+             * @brief Push an item to the bottom. Can be called only by the owner.
+             * @param item
+             */
+            void push(T item) {
+                const index_t b = bottom_.load(std::memory_order_relaxed);
+                const index_t t = top_.load(std::memory_order_acquire);
+                RingBuffer* buffer = buffer_.load(std::memory_order_relaxed);
+                if (b - t > buffer->capacity() - 1) {
+                    // thieves can still read from the old buffer, keep it until destruction
+                    buffers_.emplace_back(buffer->grow(b, t));
+                    buffer = buffers_.back().get();
+                    buffer_.store(buffer, std::memory_order_release);
+                }
+                buffer->put(b, item);
+                std::atomic_thread_fence(std::memory_order_release);
+                bottom_.store(b + 1, std::memory_order_relaxed);
+            }
+
+            /**
+             * @brief Pop the most recently pushed item. Can be called only by the owner.
+             * @return std::nullopt if the deque is empty or the last item was stolen, item otherwise.
+             */
+            std::optional<T> pop() {
+                const index_t b = bottom_.load(std::memory_order_relaxed) - 1;
+                RingBuffer* buffer = buffer_.load(std::memory_order_relaxed);
+                bottom_.store(b, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                index_t t = top_.load(std::memory_order_relaxed);
+
+                if (t > b) {
+                    // empty
+                    bottom_.store(b + 1, std::memory_order_relaxed);
+                    return std::nullopt;
+                }
+
+                T item = buffer->get(b);
+                if (t == b) {
+                    // last item, race with thieves
+                    const bool won = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                                  std::memory_order_relaxed);
+                    bottom_.store(b + 1, std::memory_order_relaxed);
+                    if (!won)
+                        return std::nullopt;
+                }
+                return item;
+            }
+
+            /**
+             * @brief Steal the least recently pushed item. Can be called by any thread.
+             * @return std::nullopt if the deque is empty or other thread was faster, item otherwise.
+             */
+            std::optional<T> steal() {
+                index_t t = top_.load(std::memory_order_acquire);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                const index_t b = bottom_.load(std::memory_order_acquire);
+                if (t >= b)
+                    return std::nullopt;
+
+                const RingBuffer* buffer = buffer_.load(std::memory_order_acquire);
+                T item = buffer->get(t);
+                if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    return std::nullopt;
+                return item;
+            }
+
+            /**
+             * @brief Position of the bottom end, items pushed later have higher positions.
+             *        Exact only for the owner.
+             */
+            [[nodiscard]] index_t bottom() const {
+                return bottom_.load(std::memory_order_relaxed);
+            }
+
+            /**
+             * @brief Approximate number of items, exact only if no other thread is working with the deque.
+             */
+            [[nodiscard]] std::size_t size() const {
+                const index_t b = bottom_.load(std::memory_order_relaxed);
+                const index_t t = top_.load(std::memory_order_relaxed);
+                return static_cast<std::size_t>(b > t ? b - t : 0);
+            }
+
+            [[nodiscard]] bool empty() const {
+                return size() == 0;
+            }
+
+        private:
+            #ifdef GTEST_FLAG
+            FRIEND_TEST(testWorkStealingDeque, Grow);
+            #endif
+
+            alignas(parameters::cacheline_size) std::atomic<index_t> top_{0};
+            alignas(parameters::cacheline_size) std::atomic<index_t> bottom_{0};
+            alignas(parameters::cacheline_size) std::atomic<RingBuffer*> buffer_{nullptr};
+            std::vector<std::unique_ptr<RingBuffer>> buffers_;
+    };
+}
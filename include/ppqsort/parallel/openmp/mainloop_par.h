@@ -3,6 +3,9 @@
 #include <omp.h>
 
 #include "../../mainloop.h"
+#include "../../radix.h"
+#include "../parallelism.h"
+#include "merge_sort_par.h"
 #include "partition_par.h"
 #include "partition_branchless_par.h"
 
@@ -50,7 +53,37 @@ namespace ppqsort::impl {
                 // pivot is the same as previous pivot
                 // put same elements to the left, and we do not have to recurse
                 if (!leftmost && !comp(*(begin-1), *begin)) {
-                    begin = partition_to_left(begin, end, comp) + 1;
+                    if (threads < 2)
+                        begin = partition_to_left(begin, end, comp) + 1;
+                    else
+                        begin = (branchless ? partition_left_branchless_par(begin, end, comp, threads)
+                                            : partition_to_left_par(begin, end, comp, threads)) + 1;
+                    continue;
+                }
+
+                // many keys equal to the pivot, gather them in the middle and never touch them again
+                if (threads >= 2 && many_equal_to_pivot(begin, size, comp)) {
+                    const auto [eq_begin, eq_end] = partition_three_way_par<branchless>(begin, end, comp, threads);
+                    const diff_t l_size = eq_begin - begin;
+                    const diff_t r_size = end - eq_end;
+                    // too few equal keys were found and the partition is unbalanced
+                    if ((eq_end - eq_begin) < size / parameters::partition_ratio &&
+                        (l_size < size / parameters::partition_ratio || r_size < size / parameters::partition_ratio) &&
+                        --bad_allowed == 0) {
+                        merge_sort_par<RandomIt, Compare, branchless>(begin, end, comp, threads);
+                        return;
+                    }
+                    int l_threads;
+                    std::tie(l_threads, threads) = split_threads(threads, l_size, r_size);
+                    if (l_size > 0) {
+                        #pragma omp task
+                        par_loop<RandomIt, Compare, branchless>(begin, eq_begin, comp, bad_allowed, seq_thr,
+                                                                l_threads, leftmost);
+                    }
+                    if (eq_end == end)
+                        return;
+                    leftmost = false;
+                    begin = eq_end;
                     continue;
                 }
 
@@ -90,20 +123,21 @@ namespace ppqsort::impl {
                                          r_size < size / parameters::partition_ratio;
 
                 if (highly_unbalanced) {
-                    // switch to heapsort
+                    // switch to parallel merge sort, it keeps O(n log n) and all the threads busy
                     if (--bad_allowed == 0) {
-                        std::make_heap(begin, end, comp);
-                        std::sort_heap(begin, end, comp);
+                        merge_sort_par<RandomIt, Compare, branchless>(begin, end, comp, threads);
                         return;
                     }
                     // partition unbalanced, shuffle elements
                     deterministic_shuffle(begin, end, l_size, r_size, pivot_pos, insertion_threshold);
                 }
 
-                threads >>= 1;
+                // threads are split proportionally to sizes of the parts
+                int l_threads;
+                std::tie(l_threads, threads) = split_threads(threads, l_size, r_size);
                 #pragma omp task
                 par_loop<RandomIt, Compare, branchless>(begin, pivot_pos, comp, bad_allowed, seq_thr,
-                                                        threads, leftmost);
+                                                        l_threads, leftmost);
                 leftmost = false;
                 begin = ++pivot_pos;
             }
@@ -115,7 +149,8 @@ namespace ppqsort::impl {
          typename Compare = std::less<typename std::iterator_traits<RandomIt>::value_type>,
          bool Branchless = use_branchless<typename std::iterator_traits<RandomIt>::value_type, Compare>::value>
     void par_ppqsort(RandomIt begin, RandomIt end,
-                     Compare comp = Compare(), const int threads = omp_get_max_threads()) {
+                     Compare comp = Compare(),
+                     const int threads = std::min(omp_get_max_threads(), default_threads())) {
         using diff_t = typename std::iterator_traits<RandomIt>::difference_type;
         if (begin == end)
             return;
@@ -147,4 +182,27 @@ namespace ppqsort::impl {
             Compare comp = Compare();
             par_ppqsort<Force_branchless>(begin, end, comp, threads);
         }
+
+    /**
+     * @brief Parallel radix sort, entry point of execution::par_radix.
+     *        Falls back to par_ppqsort, if the scratch buffer cannot be allocated.
+     */
+    template <typename RandomIt,
+              typename Compare = std::less<typename std::iterator_traits<RandomIt>::value_type>>
+    void par_radix_ppqsort(RandomIt begin, RandomIt end, Compare comp = Compare(),
+                           const int threads = std::min(omp_get_max_threads(), default_threads())) {
+        if ((threads < 2) || (end - begin < parameters::seq_threshold))
+            return seq_radix_ppqsort(begin, end, comp);
+        radix_ppqsort(begin, end, comp, threads,
+                      [](const int count, const auto& task) { openmp::run_parallel(count, task); },
+                      [begin, end, threads](const auto& fallback_comp) {
+                          par_ppqsort(begin, end, fallback_comp, threads);
+                      });
+    }
+
+    template <typename RandomIt,
+              typename Compare = std::less<typename std::iterator_traits<RandomIt>::value_type>>
+    void par_radix_ppqsort(RandomIt begin, RandomIt end, const int threads) {
+        par_radix_ppqsort(begin, end, Compare(), threads);
+    }
 }
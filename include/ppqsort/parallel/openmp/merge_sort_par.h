@@ -0,0 +1,65 @@
+#pragma once
+
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include <omp.h>
+
+#include "../../mainloop.h"
+#include "../../merge.h"
+
+namespace ppqsort::impl::openmp {
+
+    /**
+     * @brief Parallel merge sort, replaces heapsort after too many bad partitions and keeps O(n log n) worst case.
+     *        Runs are sorted by seq_loop in a buffer and merged back by all threads, each merge is split by merge path.
+     *        If the range is too small for all threads or the buffer cannot be allocated, heapsort is used.
+     */
+    template <typename RandomIt, typename Compare, bool branchless,
+              typename T = typename std::iterator_traits<RandomIt>::value_type,
+              typename diff_t = typename std::iterator_traits<RandomIt>::difference_type>
+    inline void merge_sort_par(const RandomIt begin, const RandomIt end, Compare comp, int threads) {
+        const diff_t size = end - begin;
+        threads = static_cast<int>(std::min(static_cast<diff_t>(threads), size / parameters::merge_leaf_threshold));
+        const MergeBuffer<T> buffer(threads < 2 ? 0 : size);
+        if (threads < 2 || !buffer.data()) {
+            std::make_heap(begin, end, comp);
+            std::sort_heap(begin, end, comp);
+            return;
+        }
+
+        T* const buf = buffer.data();
+        const MergeSortPlan<diff_t> plan(size, threads);
+        std::vector<diff_t> splits;
+        #pragma omp parallel num_threads(threads)
+        {
+            #pragma omp for schedule(dynamic, 1)
+            for (int run = 0; run < plan.runs; ++run) {
+                const diff_t first = plan.bound(run);
+                const diff_t last = plan.bound(run + 1);
+                std::uninitialized_move(begin + first, begin + last, buf + first);
+                seq_loop<T*, Compare, branchless>(buf + first, buf + last, comp, log2<diff_t>(last - first));
+            }
+
+            // odd number of rounds, the last one is from the buffer to the input
+            for (int round = 0; round < plan.rounds; ++round) {
+                #pragma omp single
+                splits = round % 2 == 0 ? plan.splits(buf, round, comp) : plan.splits(begin, round, comp);
+                #pragma omp for schedule(dynamic, 1)
+                for (int task = 0; task < plan.tasks(round); ++task) {
+                    if (round % 2 == 0)
+                        plan.merge(buf, begin, round, task, splits, comp);
+                    else
+                        plan.merge(begin, buf, round, task, splits, comp);
+                }
+            }
+
+            if constexpr (!std::is_trivially_destructible_v<T>) {
+                #pragma omp for
+                for (int run = 0; run < plan.runs; ++run)
+                    std::destroy(buf + plan.bound(run), buf + plan.bound(run + 1));
+            }
+        }
+    }
+}
@@ -122,6 +122,41 @@ namespace ppqsort::impl::openmp {
                               block_size);
         }  // End of parallel segment
 
-        return seq_cleanup<true>(g_begin, g_pivot, comp, g_first_offset, g_last_offset, g_already_partitioned);
+        // dirty segment is partitioned by the same threads
+        return par_cleanup<true>(g_begin, g_pivot, comp, g_first_offset, g_last_offset, g_already_partitioned,
+                                 thread_count, [](const int count, const auto& task) { run_parallel(count, task); });
+    }
+
+    /**
+     * @brief Parallel branchless partition_to_left, elements equal to the pivot go to the left part.
+     *        Reuses the blocks of partition_right_branchless_par with the inverted comparator.
+     * @return Iterator to pivot
+     */
+    template <typename RandomIt, typename Compare>
+    inline RandomIt partition_left_branchless_par(const RandomIt g_begin, const RandomIt g_end, Compare comp,
+                                                  const int thread_count) {
+        // sequential fallback of partition_right_branchless relies on sentinels, so small inputs are handled here
+        if ((g_end - g_begin) - 1 < 2 * parameters::buffer_size * thread_count)
+            return partition_to_left(g_begin, g_end, comp);
+        return partition_right_branchless_par(g_begin, g_end, inverted_compare<Compare>{comp}, thread_count).first;
+    }
+
+    /**
+     * @brief Parallel three-way partition, elements less than the pivot go to the left,
+     *        elements equal to the pivot to the middle and greater elements to the right.
+     *        The first pass is the usual partition_right, the second pass splits only its right part.
+     * @return Range of elements equal to the pivot
+     */
+    template <bool branchless, typename RandomIt, typename Compare>
+    inline std::pair<RandomIt, RandomIt> partition_three_way_par(const RandomIt g_begin, const RandomIt g_end,
+                                                                 Compare comp, const int thread_count) {
+        const RandomIt pivot_pos = branchless
+                                   ? partition_right_branchless_par(g_begin, g_end, comp, thread_count).first
+                                   : partition_to_right_par(g_begin, g_end, comp, thread_count).first;
+        // pivot is at the start of the right part, so it can be partitioned again around the same pivot
+        const RandomIt last_equal = branchless
+                                    ? partition_left_branchless_par(pivot_pos, g_end, comp, thread_count)
+                                    : partition_to_left_par(pivot_pos, g_end, comp, thread_count);
+        return {pivot_pos, last_equal + 1};
     }
 }
@@ -2,6 +2,16 @@
 
 namespace ppqsort::impl::openmp {
 
+    /**
+     * @brief Run task(0), ..., task(count - 1) by a team of count threads and wait for them.
+     */
+    template <typename Task>
+    inline void run_parallel(const int count, const Task& task) {
+        #pragma omp parallel for num_threads(count)
+        for (int i = 0; i < count; ++i)
+            task(i);
+    }
+
     #if (defined(__GNUC__) && !defined(__clang__)) && !defined(__INTEL_COMPILER)
         #define GCC_COMPILER
     #endif
@@ -242,7 +252,22 @@ namespace ppqsort::impl::openmp {
                               block_size);
         }  // End of a parallel section
 
-        // do sequential cleanup of dirty segment
-        return seq_cleanup<false>(g_begin, pivot, comp, g_first_offset, g_last_offset, g_already_partitioned);
+        // dirty segment is partitioned by the same threads
+        return par_cleanup<false>(g_begin, pivot, comp, g_first_offset, g_last_offset, g_already_partitioned,
+                                  thread_count, [](const int count, const auto& task) { run_parallel(count, task); });
+    }
+
+    /**
+     * @brief Parallel partition_to_left, elements equal to the pivot go to the left part.
+     *        Reuses the blocks of partition_to_right_par with the inverted comparator.
+     * @return Iterator to pivot
+     */
+    template <typename RandomIt, typename Compare>
+    inline RandomIt partition_to_left_par(const RandomIt& g_begin, const RandomIt& g_end, const Compare& comp,
+                                          const int& thread_count) {
+        // sequential fallback of partition_to_right relies on sentinels, so small inputs are handled here
+        if ((g_end - g_begin) - 1 < 2 * parameters::par_partition_block_size * thread_count)
+            return partition_to_left(g_begin, g_end, comp);
+        return partition_to_right_par(g_begin, g_end, inverted_compare<Compare>{comp}, thread_count).first;
     }
 }
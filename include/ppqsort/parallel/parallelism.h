@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace ppqsort::impl {
+
+    /**
+     * @var cgroup_root
+     * @brief Mount point of the cgroup filesystem.
+     */
+    inline constexpr const char* cgroup_root = "/sys/fs/cgroup";
+    /**
+     * @var proc_self_cgroup
+     * @brief File with cgroups of the current process.
+     */
+    inline constexpr const char* proc_self_cgroup = "/proc/self/cgroup";
+
+    /**
+     * @brief Number of CPUs allowed by the cgroup CPU quota (v2 cpu.max or v1 cpu.cfs_quota_us),
+     *        the smallest quota of the process cgroup and all its ancestors is used.
+     * @param root Mount point of the cgroup filesystem, can be replaced for testing.
+     * @param proc_cgroup File in the /proc/self/cgroup format, paths of the process cgroups are read from it.
+     * @return 0 if there is no quota.
+     */
+    inline int cgroup_cpu_limit(const std::string& root = cgroup_root,
+                                const std::string& proc_cgroup = proc_self_cgroup) {
+        namespace fs = std::filesystem;
+
+        // cgroup v2: "max 100000" or "<quota> <period>"
+        const auto read_v2 = [](const fs::path& dir, double& quota, double& period) {
+            std::ifstream file(dir / "cpu.max");
+            std::string max;
+            return (file >> max >> period) && max != "max" && (std::istringstream(max) >> quota);
+        };
+        // cgroup v1: quota is -1 if unlimited
+        const auto read_v1 = [](const fs::path& dir, double& quota, double& period) {
+            std::ifstream quota_file(dir / "cpu.cfs_quota_us");
+            std::ifstream period_file(dir / "cpu.cfs_period_us");
+            return (quota_file >> quota) && (period_file >> period) && quota > 0;
+        };
+
+        // paths of the process cgroups relative to the hierarchy root, "/" inside of a cgroup namespace
+        std::string v2_path = "/";
+        std::string v1_path = "/";
+        std::ifstream proc(proc_cgroup);
+        for (std::string line; std::getline(proc, line);) {
+            // hierarchy-ID:controller-list:cgroup-path
+            const auto first = line.find(':');
+            const auto second = line.find(':', first + 1);
+            if (first == std::string::npos || second == std::string::npos)
+                continue;
+            const std::string controllers = line.substr(first + 1, second - first - 1);
+            const std::string path = line.substr(second + 1);
+            if (controllers.empty()) {
+                v2_path = path;
+            } else {
+                std::stringstream list(controllers);
+                for (std::string controller; std::getline(list, controller, ',');)
+                    if (controller == "cpu")
+                        v1_path = path;
+            }
+        }
+
+        int limit = 0;
+        const auto check_hierarchy = [&](const fs::path& base, const std::string& path, const auto& read) {
+            // walk from the process cgroup up to the root, any ancestor can set a lower quota
+            fs::path relative = fs::path(path).relative_path();
+            while (true) {
+                double quota, period;
+                if (read(base / relative, quota, period) && period > 0) {
+                    const int cpus = std::max(1, static_cast<int>(std::ceil(quota / period)));
+                    limit = limit ? std::min(limit, cpus) : cpus;
+                }
+                if (relative.empty())
+                    break;
+                relative = relative.parent_path();
+            }
+        };
+        check_hierarchy(root, v2_path, read_v2);
+        check_hierarchy(fs::path(root) / "cpu", v1_path, read_v1);
+        check_hierarchy(fs::path(root) / "cpu,cpuacct", v1_path, read_v1);
+        return limit;
+    }
+
+    /**
+     * @brief Number of CPUs, which the process can really use.
+     *        It is the minimum of the affinity mask size and the cgroup CPU quota,
+     *        std::thread::hardware_concurrency() reports all CPUs of the machine, even in a container.
+     * @param root Mount point of the cgroup filesystem, can be replaced for testing.
+     * @param proc_cgroup File in the /proc/self/cgroup format.
+     */
+    inline int effective_parallelism(const std::string& root = cgroup_root,
+                                     const std::string& proc_cgroup = proc_self_cgroup) {
+        int cpus = static_cast<int>(std::thread::hardware_concurrency());
+        #ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0)
+            cpus = CPU_COUNT(&set);
+        #endif
+        if (const int limit = cgroup_cpu_limit(root, proc_cgroup); limit > 0)
+            cpus = std::min(cpus, limit);
+        return std::max(cpus, 1);
+    }
+
+    /**
+     * @brief Default number of threads for parallel sorts.
+     *        Computed on the first call, so the sorts do not read the cgroup files again.
+     */
+    inline int default_threads() {
+        static const int threads = effective_parallelism();
+        return threads;
+    }
+}
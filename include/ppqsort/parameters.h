@@ -91,6 +91,16 @@ namespace ppqsort::parameters {
     using buffer_type = uint16_t;
     static_assert(std::numeric_limits<buffer_type>::max() > buffer_size,
                   "buffer_size is bigger than type for buffer can hold. This will overflow");
+    /**
+     * @var equal_keys_samples
+     * @brief Number of samples used to detect many keys equal to the pivot.
+     */
+    constexpr int equal_keys_samples = 32;
+    /**
+     * @var equal_keys_ratio
+     * @brief Three-way partition is used, if at least 1/equal_keys_ratio of the samples is equal to the pivot.
+     */
+    constexpr int equal_keys_ratio = 4;
     /**
      * @var par_thr_div
      * @brief Division of threshold for computing sequential threshold (aka constant "k").
@@ -106,6 +116,47 @@ namespace ppqsort::parameters {
      * @brief Minimal size for using parallel sort.
      */
     constexpr int seq_threshold = 1 << 18;
+    /**
+     * @var merge_leaf_threshold
+     * @brief Minimal size of a run sorted by one thread in the parallel merge sort,
+     *        which replaces heapsort after too many bad partitions.
+     */
+    constexpr int merge_leaf_threshold = 1 << 14;
+    /**
+     * @var radix_threshold
+     * @brief Minimal size for using radix sort, smaller ranges are sorted by seq_loop.
+     */
+    constexpr int radix_threshold = 1 << 12;
+    /**
+     * @var radix_chunk_size
+     * @brief Minimal size of a chunk processed by one thread in the radix sort.
+     */
+    constexpr int radix_chunk_size = 1 << 16;
+    /**
+     * @var radix_digit_bits
+     * @brief Number of key bits sorted in one pass of the radix sort.
+     */
+    constexpr int radix_digit_bits = 8;
+    /**
+     * @var task_size
+     * @brief Size of the task object in the thread pool, bigger tasks are allocated on the heap.
+     */
+    constexpr std::size_t task_size = 2 * cacheline_size;
+    /**
+     * @var pool_spin_iterations
+     * @brief Number of spins of an idle worker, before it starts to yield.
+     */
+    constexpr unsigned int pool_spin_iterations = 1 << 10;
+    /**
+     * @var pool_yield_iterations
+     * @brief Number of yields of an idle worker, before it goes to sleep.
+     */
+    constexpr unsigned int pool_yield_iterations = 16;
+    /**
+     * @var numa_page_samples
+     * @brief Number of pages sampled to find the NUMA node, which holds most of the range.
+     */
+    constexpr int numa_page_samples = 16;
 } // namespace ppqsort::parameters
 
 namespace ppqsort::execution {
@@ -113,6 +164,7 @@ namespace ppqsort::execution {
     class parallel_policy {};
     class sequenced_policy_force_branchless {};
     class parallel_policy_force_branchless {};
+    class parallel_policy_radix {};
 
     /**
      * @var seq
@@ -134,6 +186,12 @@ namespace ppqsort::execution {
      * @brief Parallel execution policy with forced branchless partitioning.
      */
     inline constexpr parallel_policy_force_branchless par_force_branchless{};
+    /**
+     * @var par_radix
+     * @brief Parallel execution policy using radix sort. Needs std::less or std::greater with an integer or float type,
+     *        or a projection returning an integer or float key (e.g. packed by ppqsort::radix_key) instead of the comparator.
+     */
+    inline constexpr parallel_policy_radix par_radix{};
 
     template<typename T, typename U>
     inline constexpr bool _is_same_decay_v = std::is_same_v<std::decay_t<T>, std::decay_t<U>>;
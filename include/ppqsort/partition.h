@@ -1,5 +1,10 @@
 #pragma once
 
+#include <algorithm>
+#include <tuple>
+#include <vector>
+
+#include "parameters.h"
 #include "partition_branchless.h"
 
 namespace ppqsort::impl {
@@ -49,6 +54,22 @@ namespace ppqsort::impl {
         return pivotPos;
     }
 
+    /**
+     * @brief Comparator, which turns partition to the right into partition to the left.
+     *        inverted_compare(a, b) == !comp(b, a), so elements equal to the pivot go to the left part.
+     * @Note  It is not a strict weak ordering, use it only with partitioning on the pivot,
+     *        which does not rely on sentinels in the input (e.g. parallel partitions).
+     */
+    template <typename Compare>
+    struct inverted_compare {
+        Compare comp;
+
+        template <typename A, typename B>
+        bool operator()(const A& a, const B& b) const {
+            return !comp(b, a);
+        }
+    };
+
     template <typename RandomIt, typename Compare, typename T = typename std::iterator_traits<RandomIt>::value_type>
     inline std::pair<RandomIt, bool> partition_to_right(RandomIt begin, RandomIt end, Compare comp) {
         T pivot = std::move(*begin);
@@ -92,7 +113,8 @@ namespace ppqsort::impl {
         RandomIt final_first = g_begin + g_first_offset - 1;
         RandomIt final_last = g_begin + g_last_offset + 1;
 
-        while (final_first < final_last && comp(*++final_first, pivot));
+        // final_last can be the end of the range, when all blocks on the right were dirty
+        while (++final_first < final_last && comp(*final_first, pivot));
         while (final_first < final_last && !comp(*--final_last, pivot));
         const bool cleanup_already_partitioned = final_first >= final_last;
 
@@ -118,4 +140,180 @@ namespace ppqsort::impl {
         *pivot_pos = std::move(pivot);
         return std::make_pair(pivot_pos, g_already_partitioned);
     }
+
+    /**
+     * @brief Partition [first, last) around the pivot, elements less than the pivot go to the left.
+     *        Nothing outside the range is touched, so chunks of a range can be partitioned concurrently.
+     * @return Iterator to the first element not less than the pivot and whether the range was already partitioned.
+     */
+    template <bool branchless, typename RandomIt, typename Compare, typename T>
+    inline std::pair<RandomIt, bool> partition_chunk(RandomIt first, RandomIt last, const T& pivot,
+                                                     const Compare& comp) {
+        while (first < last && comp(*first, pivot))
+            ++first;
+        while (first < last && !comp(*(last - 1), pivot))
+            --last;
+        if (first == last)
+            return std::make_pair(first, true);
+
+        // now *first is not less than the pivot and *last is less than the pivot, they guard the loops
+        --last;
+        if constexpr (branchless) {
+            std::iter_swap(first++, last--);
+            partition_branchless_core(first, last, pivot, comp);
+        } else {
+            while (first < last) {
+                std::iter_swap(first, last);
+                while (comp(*++first, pivot));
+                while (!comp(*--last, pivot));
+            }
+        }
+        return std::make_pair(first, false);
+    }
+
+    /**
+     * @brief Parallel cleanup of a partition, which left several dirty intervals in [1, g_end_offset).
+     *        Elements outside of the dirty intervals are less than the pivot before clean_split and not less from it on.
+     *        Dirty intervals are split to chunks, which are partitioned concurrently.
+     *        Then elements not less than the pivot before the final pivot position are swapped
+     *        with the less elements after it, also concurrently.
+     * @param dirty Sorted disjoint intervals [first, last) of offsets.
+     * @param run_parallel Runs task(0), ..., task(count - 1) of run_parallel(count, task) in parallel and waits.
+     */
+    template <bool branchless, typename RandomIt, typename Compare, typename RunParallel,
+        typename T = typename std::iterator_traits<RandomIt>::value_type,
+        typename diff_t = typename std::iterator_traits<RandomIt>::difference_type>
+    inline std::pair<RandomIt, bool> par_cleanup(const RandomIt& g_begin, const T& pivot, const Compare& comp,
+                                                 const std::vector<std::pair<diff_t, diff_t>>& dirty,
+                                                 const diff_t clean_split, const diff_t g_end_offset,
+                                                 bool g_already_partitioned, const int thread_count,
+                                                 const RunParallel& run_parallel) {
+        // segments cover [1, g_end_offset), elements of a segment before its split are less than the pivot
+        struct Segment {
+            diff_t first;
+            diff_t last;
+            diff_t split;
+        };
+        std::vector<Segment> segments;
+        std::vector<std::size_t> chunks;
+        diff_t dirty_size = 0;
+        for (const auto& [first, last] : dirty)
+            dirty_size += last - first;
+        // each thread gets at least one block of the dirty intervals
+        const diff_t chunk_size = std::max(static_cast<diff_t>(parameters::par_partition_block_size),
+                                           (dirty_size + thread_count - 1) / thread_count);
+        const auto add_clean = [&](const diff_t first, const diff_t last) {
+            if (first < last)
+                segments.push_back({first, last, std::clamp(clean_split, first, last)});
+        };
+        diff_t clean_first = 1;
+        for (const auto& [first, last] : dirty) {
+            add_clean(clean_first, first);
+            const diff_t count = (last - first + chunk_size - 1) / chunk_size;
+            for (diff_t i = 0; i < count; ++i) {
+                chunks.push_back(segments.size());
+                segments.push_back({first + (last - first) * i / count, first + (last - first) * (i + 1) / count, first});
+            }
+            clean_first = last;
+        }
+        add_clean(clean_first, g_end_offset);
+
+        std::vector<unsigned char> chunk_partitioned(chunks.size(), 1);
+        if (!chunks.empty()) {
+            run_parallel(static_cast<int>(chunks.size()), [&](const int chunk) {
+                Segment& segment = segments[chunks[chunk]];
+                RandomIt split;
+                std::tie(split, chunk_partitioned[chunk]) =
+                    partition_chunk<branchless>(g_begin + segment.first, g_begin + segment.last, pivot, comp);
+                segment.split = split - g_begin;
+            });
+        }
+
+        // final position of the first element not less than the pivot
+        diff_t boundary = 1;
+        for (const Segment& segment : segments)
+            boundary += segment.split - segment.first;
+
+        // misplaced elements form intervals on both sides of the boundary, with the same total size
+        struct Interval {
+            RandomIt first;
+            diff_t offset;
+            diff_t size;
+        };
+        std::vector<Interval> wrong_left, wrong_right;
+        diff_t left_total = 0, right_total = 0;
+        for (const Segment& segment : segments) {
+            const diff_t greater_last = std::min(segment.last, boundary);
+            if (segment.split < greater_last) {
+                wrong_left.push_back({g_begin + segment.split, left_total, greater_last - segment.split});
+                left_total += wrong_left.back().size;
+            }
+            const diff_t less_first = std::max(segment.first, boundary);
+            if (less_first < segment.split) {
+                wrong_right.push_back({g_begin + less_first, right_total, segment.split - less_first});
+                right_total += wrong_right.back().size;
+            }
+        }
+
+        if (left_total > 0) {
+            const auto find = [](const std::vector<Interval>& intervals, const diff_t k) {
+                return static_cast<std::size_t>(std::upper_bound(intervals.begin(), intervals.end(), k,
+                    [](const diff_t value, const Interval& interval) { return value < interval.offset; })
+                    - intervals.begin() - 1);
+            };
+            const int tasks = static_cast<int>(std::clamp(left_total / parameters::par_partition_block_size,
+                                                          static_cast<diff_t>(1), static_cast<diff_t>(thread_count)));
+            run_parallel(tasks, [&](const int task) {
+                diff_t k = left_total * task / tasks;
+                const diff_t k_end = left_total * (task + 1) / tasks;
+                std::size_t l = find(wrong_left, k);
+                std::size_t r = find(wrong_right, k);
+                while (k < k_end) {
+                    const Interval& left = wrong_left[l];
+                    const Interval& right = wrong_right[r];
+                    const diff_t count = std::min({k_end - k, left.offset + left.size - k,
+                                                   right.offset + right.size - k});
+                    std::swap_ranges(left.first + (k - left.offset), left.first + (k - left.offset + count),
+                                     right.first + (k - right.offset));
+                    k += count;
+                    l += k == left.offset + left.size;
+                    r += k == right.offset + right.size;
+                }
+            });
+        }
+
+        g_already_partitioned &= left_total == 0 &&
+                                 std::all_of(chunk_partitioned.begin(), chunk_partitioned.end(),
+                                             [](const unsigned char x) { return x; });
+
+        // move pivot from start to according place
+        RandomIt pivot_pos = g_begin + (boundary - 1);
+        if (g_begin != pivot_pos)
+            *g_begin = std::move(*pivot_pos);
+        *pivot_pos = std::move(pivot);
+        return std::make_pair(pivot_pos, g_already_partitioned);
+    }
+
+    /**
+     * @brief Parallel version of seq_cleanup for big dirty segments [g_first_offset, g_last_offset].
+     *        Small segments are cleaned sequentially.
+     * @param run_parallel Runs task(0), ..., task(count - 1) of run_parallel(count, task) in parallel and waits.
+     */
+    template <bool branchless, typename RandomIt, typename Compare, typename RunParallel,
+        typename T = typename std::iterator_traits<RandomIt>::value_type,
+        typename diff_t = typename std::iterator_traits<RandomIt>::difference_type>
+    inline std::pair<RandomIt, bool> par_cleanup(const RandomIt& g_begin, const T& pivot,
+                                                 const Compare& comp, const diff_t& g_first_offset,
+                                                 const diff_t& g_last_offset, bool g_already_partitioned,
+                                                 const int thread_count, const RunParallel& run_parallel) {
+        // each thread gets at least one block of the dirty segment
+        const diff_t size = g_last_offset + 1 - g_first_offset;
+        if (std::min(static_cast<diff_t>(thread_count), size / parameters::par_partition_block_size) < 2)
+            return seq_cleanup<branchless>(g_begin, pivot, comp, g_first_offset, g_last_offset, g_already_partitioned);
+        // elements after the segment are not less than the pivot, so they never have to move
+        return par_cleanup<branchless>(g_begin, pivot, comp,
+                                       std::vector<std::pair<diff_t, diff_t>>{{g_first_offset, g_last_offset + 1}},
+                                       g_first_offset, g_last_offset + 1, g_already_partitioned,
+                                       thread_count, run_parallel);
+    }
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "simd.h"
+
 namespace ppqsort::impl {
 
     template<class RandomIt, typename Offset,
@@ -67,7 +69,12 @@ namespace ppqsort::impl {
             typename diff_t = typename std::iterator_traits<RandomIt>::difference_type>
     inline void populate_block(RandomIt & begin, diff_t & offset, T pivot, Offset* offsets, diff_t& count,
                                Compare comp, const int & block_size) {
-        for (int i = 0; i < block_size; ++i) {
+        int i = 0;
+        if constexpr (simd::enabled<RandomIt, Compare, Offset>) {
+            i = simd::populate_block<s, Compare>(std::to_address(begin + offset), pivot, offsets, count, block_size);
+            offset += s == left ? i : -i;
+        }
+        for (; i < block_size; ++i) {
             offsets[count] = i;
             if constexpr (s == left)
                 count += !comp(begin[offset++], pivot);
@@ -84,7 +91,12 @@ namespace ppqsort::impl {
               typename diff_t = typename std::iterator_traits<RandomIt>::difference_type>
     inline void populate_block(RandomIt & it, T & pivot, Offset* offsets, diff_t& count,
                                Compare comp, const int & block_size) {
-        for (int i = 0; i < block_size; ++i) {
+        int i = 0;
+        if constexpr (simd::enabled<RandomIt, Compare, Offset>) {
+            i = simd::populate_block<s, Compare>(std::to_address(it), pivot, offsets, count, block_size);
+            it += s == left ? i : -i;
+        }
+        for (; i < block_size; ++i) {
             offsets[count] = i;
             if constexpr (s == left)
                 count += !comp(*it++, pivot);
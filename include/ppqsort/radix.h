@@ -0,0 +1,393 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "mainloop.h"
+#include "merge.h"
+#include "parameters.h"
+
+namespace ppqsort::impl {
+    /**
+     * @brief Integers and 32-bit or 64-bit IEEE 754 floating point types can be mapped to radix keys.
+     */
+    template <typename T>
+    concept radix_keyable = std::is_integral_v<T> ||
+                            (std::is_floating_point_v<T> && std::numeric_limits<T>::is_iec559 &&
+                             (sizeof(T) == 4 || sizeof(T) == 8));
+}
+
+namespace ppqsort {
+    /**
+     * @brief Map a value to an unsigned integer of the same size, which keeps the order of std::less.
+     *        Signed integers have the sign bit flipped, negative floats have all bits flipped
+     *        and positive floats only the sign bit (-0.0 goes before +0.0, NaNs go to the ends).
+     *        Keys of several members can be packed to one 64-bit key for execution::par_radix,
+     *        e.g. (std::uint64_t{radix_key(a)} << 32) | radix_key(b) for 32-bit members a and b.
+     */
+    template <impl::radix_keyable T>
+    constexpr auto radix_key(const T value) noexcept {
+        if constexpr (std::is_same_v<T, bool>) {
+            return static_cast<std::uint8_t>(value);
+        } else if constexpr (std::is_integral_v<T>) {
+            using U = std::make_unsigned_t<T>;
+            if constexpr (std::is_signed_v<T>)
+                return static_cast<U>(static_cast<U>(value) ^ (U{1} << (std::numeric_limits<U>::digits - 1)));
+            else
+                return static_cast<U>(value);
+        } else {
+            using U = std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>;
+            const U bits = std::bit_cast<U>(value);
+            constexpr U sign = U{1} << (std::numeric_limits<U>::digits - 1);
+            return static_cast<U>(bits & sign ? ~bits : bits ^ sign);
+        }
+    }
+}
+
+namespace ppqsort::impl {
+
+    /**
+     * @brief Key function used by the radix sort. Elements are sorted by the unsigned key in ascending order.
+     *        Default comparators use radix_key of the elements, std::greater inverts it.
+     *        Other callables are projections, which return an integer or float key of an element.
+     */
+    template <typename T, typename Compare>
+    struct radix_key_of {
+        Compare key;
+
+        auto operator()(const T& value) const {
+            return radix_key(std::invoke(key, value));
+        }
+    };
+
+    template <typename T, typename U>
+    struct radix_key_of<T, std::less<U>> {
+        explicit radix_key_of(std::less<U>) {}
+        auto operator()(const T& value) const { return radix_key(value); }
+    };
+
+    template <typename T>
+    struct radix_key_of<T, std::ranges::less> {
+        explicit radix_key_of(std::ranges::less) {}
+        auto operator()(const T& value) const { return radix_key(value); }
+    };
+
+    template <typename T, typename U>
+    struct radix_key_of<T, std::greater<U>> {
+        explicit radix_key_of(std::greater<U>) {}
+        auto operator()(const T& value) const { return static_cast<decltype(radix_key(value))>(~radix_key(value)); }
+    };
+
+    template <typename T>
+    struct radix_key_of<T, std::ranges::greater> {
+        explicit radix_key_of(std::ranges::greater) {}
+        auto operator()(const T& value) const { return static_cast<decltype(radix_key(value))>(~radix_key(value)); }
+    };
+
+    /**
+     * @brief Radix sort is possible for default comparators of radix_keyable types
+     *        and for projections returning a radix_keyable key.
+     */
+    template <typename T, typename Compare>
+    inline constexpr bool radix_sortable = [] {
+        if constexpr (is_default_comparator<std::decay_t<Compare>>::value) {
+            return radix_keyable<T>;
+        } else if constexpr (std::is_invocable_v<const Compare&, const T&>) {
+            return radix_keyable<std::decay_t<std::invoke_result_t<const Compare&, const T&>>>;
+        } else {
+            return false;
+        }
+    }();
+
+    /**
+     * @brief Comparator equivalent to the radix key, used when radix sort does not pay off.
+     */
+    template <typename KeyOf>
+    struct radix_compare {
+        KeyOf key_of;
+
+        template <typename T>
+        bool operator()(const T& a, const T& b) const {
+            return key_of(a) < key_of(b);
+        }
+    };
+
+    /**
+     * @brief Comparator for sorting the range by comparisons instead of the radix sort.
+     */
+    template <typename T, typename Compare>
+    inline auto radix_fallback_compare(const Compare& comp) {
+        if constexpr (is_default_comparator<std::decay_t<Compare>>::value)
+            return comp;
+        else
+            return radix_compare<radix_key_of<T, Compare>>{radix_key_of<T, Compare>{comp}};
+    }
+
+    /**
+     * @brief Sequential comparison sort with the comparator from radix_fallback_compare.
+     */
+    template <typename RandomIt, typename Compare,
+              typename T = typename std::iterator_traits<RandomIt>::value_type,
+              typename diff_t = typename std::iterator_traits<RandomIt>::difference_type>
+    inline void radix_seq_fallback(const RandomIt begin, const RandomIt end, const Compare& comp) {
+        seq_loop<RandomIt, Compare, use_branchless<T, Compare>::value>(begin, end, comp, log2<diff_t>(end - begin));
+    }
+
+    template <typename diff_t>
+    using RadixCounts = std::array<diff_t, std::size_t{1} << parameters::radix_digit_bits>;
+
+    /**
+     * @brief Most significant digit radix sort. Each level counts the digits of a bucket in chunks,
+     *        computes the output offsets of each chunk (prefix sum over digits and chunks)
+     *        and scatters the elements stably between the input and a scratch buffer of the same size.
+     *        Top levels run on all threads. Buckets smaller than size / threads are sorted by one thread each,
+     *        bigger buckets are sorted one after another with all threads again.
+     *        Levels, in which all elements of a bucket have the same digit, are skipped.
+     *        Buckets smaller than radix_threshold are moved back to the input and sorted by comparisons.
+     */
+    template <typename RandomIt, typename KeyOf, typename Compare, typename RunParallel,
+              typename T = typename std::iterator_traits<RandomIt>::value_type,
+              typename diff_t = typename std::iterator_traits<RandomIt>::difference_type>
+    class RadixSort {
+        public:
+            using Key = std::decay_t<std::invoke_result_t<const KeyOf&, const T&>>;
+            static_assert(std::is_unsigned_v<Key>, "Radix key must be an unsigned integer.");
+            static constexpr int digit_bits = parameters::radix_digit_bits;
+            static constexpr int buckets = 1 << digit_bits;
+
+            /**
+             * @param buffer Scratch space for size elements. Elements of trivially copyable types are assigned to it,
+             *               other types must be constructed in it and moved there before the sort.
+             */
+            RadixSort(const RandomIt begin, T* const buffer, const KeyOf& key_of, const Compare& comp,
+                      const RunParallel& run_parallel)
+                : begin_(begin), buf_(buffer), key_of_(key_of), comp_(comp), run_parallel_(run_parallel) {}
+
+            /**
+             * @brief Digit of the most significant bit, in which the keys of [first, first + size) differ.
+             * @return -1 if all keys are the same.
+             */
+            [[nodiscard]] int top_pass(const diff_t first, const diff_t size, const bool in_buffer,
+                                       const int threads) const {
+                std::vector<Key> differ(threads);
+                const Key pivot = in_buffer ? key_of_(buf_[first]) : key_of_(begin_[first]);
+                run_parallel_(threads, [&](const int chunk) {
+                    const diff_t chunk_first = first + size * chunk / threads;
+                    const diff_t chunk_last = first + size * (chunk + 1) / threads;
+                    const auto differ_bits = [this, pivot](const auto it_first, const auto it_last) {
+                        Key bits = 0;
+                        for (auto it = it_first; it != it_last; ++it)
+                            bits |= key_of_(*it) ^ pivot;
+                        return bits;
+                    };
+                    differ[chunk] = in_buffer ? differ_bits(buf_ + chunk_first, buf_ + chunk_last)
+                                              : differ_bits(begin_ + chunk_first, begin_ + chunk_last);
+                });
+                Key bits = 0;
+                for (const Key chunk_bits : differ)
+                    bits |= chunk_bits;
+                return (static_cast<int>(std::bit_width(bits)) + digit_bits - 1) / digit_bits - 1;
+            }
+
+            /**
+             * @brief Sort [first, first + size) by the digits pass, ..., 0 and leave it in the input.
+             *        Higher digits of the range are equal.
+             * @param in_buffer Elements are in the scratch buffer, not in the input.
+             */
+            void sort(const diff_t first, const diff_t size, int pass, bool in_buffer, int threads) const {
+                // chunks must be big enough to pay for the synchronization
+                threads = static_cast<int>(std::clamp(size / parameters::radix_chunk_size, static_cast<diff_t>(1),
+                                                      static_cast<diff_t>(threads)));
+                std::vector<RadixCounts<diff_t>> counts(threads);
+                RadixCounts<diff_t> digit_start;
+                for (; pass >= 0 && size >= parameters::radix_threshold; --pass) {
+                    if (count(first, size, pass, in_buffer, counts, digit_start))
+                        break;
+                }
+                if (pass < 0 || size < parameters::radix_threshold)
+                    return finish(first, size, in_buffer, pass >= 0);
+
+                if (in_buffer)
+                    scatter(buf_ + first, begin_ + first, size, pass, counts, digit_start);
+                else
+                    scatter(begin_ + first, buf_ + first, size, pass, counts, digit_start);
+                in_buffer = !in_buffer;
+
+                // bucket offsets and sizes, big buckets are sorted by all threads
+                std::vector<std::pair<diff_t, diff_t>> small;
+                for (int d = 0; d < buckets; ++d) {
+                    const diff_t bucket_size = (d + 1 < buckets ? digit_start[d + 1] : size) - digit_start[d];
+                    if (bucket_size == 0)
+                        continue;
+                    if (threads > 1 && bucket_size > size / threads)
+                        sort(first + digit_start[d], bucket_size, pass - 1, in_buffer, threads);
+                    else
+                        small.emplace_back(first + digit_start[d], bucket_size);
+                }
+                if (threads < 2) {
+                    for (const auto& [bucket_first, bucket_size] : small)
+                        sort(bucket_first, bucket_size, pass - 1, in_buffer, 1);
+                    return;
+                }
+                // the biggest buckets go first, threads take the next bucket when they are done
+                std::sort(small.begin(), small.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+                std::atomic<std::size_t> next{0};
+                run_parallel_(threads, [&](int) {
+                    for (std::size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < small.size();)
+                        sort(small[i].first, small[i].second, pass - 1, in_buffer, 1);
+                });
+            }
+
+        private:
+            [[nodiscard]] static std::size_t digit(const Key key, const int pass) {
+                return static_cast<std::size_t>(key >> (pass * digit_bits)) & (buckets - 1);
+            }
+
+            /**
+             * @brief Count digits of each chunk and compute the first position of each digit.
+             * @return False if all elements have the same digit.
+             */
+            bool count(const diff_t first, const diff_t size, const int pass, const bool in_buffer,
+                       std::vector<RadixCounts<diff_t>>& counts, RadixCounts<diff_t>& digit_start) const {
+                const int threads = static_cast<int>(counts.size());
+                run_parallel_(threads, [&](const int chunk) {
+                    const diff_t chunk_first = first + size * chunk / threads;
+                    const diff_t chunk_last = first + size * (chunk + 1) / threads;
+                    // local copy, the counters would alias the bounds
+                    RadixCounts<diff_t> local{};
+                    const auto count_digits = [&](const auto it_first, const auto it_last) {
+                        for (auto it = it_first; it != it_last; ++it)
+                            ++local[digit(key_of_(*it), pass)];
+                    };
+                    if (in_buffer)
+                        count_digits(buf_ + chunk_first, buf_ + chunk_last);
+                    else
+                        count_digits(begin_ + chunk_first, begin_ + chunk_last);
+                    counts[chunk] = local;
+                });
+                bool differ = true;
+                diff_t start = 0;
+                for (int d = 0; d < buckets; ++d) {
+                    diff_t total = 0;
+                    for (const RadixCounts<diff_t>& local : counts)
+                        total += local[d];
+                    digit_start[d] = start;
+                    start += total;
+                    differ &= total != size;
+                }
+                return differ;
+            }
+
+            // elements of a chunk go after the same digits of the chunks before it, so the scatter is stable
+            template <typename Src, typename Dst>
+            void scatter(const Src src, const Dst dst, const diff_t size, const int pass,
+                         const std::vector<RadixCounts<diff_t>>& counts,
+                         const RadixCounts<diff_t>& digit_start) const {
+                const int threads = static_cast<int>(counts.size());
+                run_parallel_(threads, [&](const int chunk) {
+                    RadixCounts<diff_t> offsets = digit_start;
+                    for (int c = 0; c < chunk; ++c)
+                        for (int d = 0; d < buckets; ++d)
+                            offsets[d] += counts[c][d];
+                    const Src last = src + size * (chunk + 1) / threads;
+                    for (Src it = src + size * chunk / threads; it != last; ++it)
+                        dst[offsets[digit(key_of_(*it), pass)]++] = std::move(*it);
+                });
+            }
+
+            void finish(const diff_t first, const diff_t size, const bool in_buffer, const bool compare) const {
+                if (in_buffer)
+                    std::move(buf_ + first, buf_ + first + size, begin_ + first);
+                if (compare)
+                    radix_seq_fallback(begin_ + first, begin_ + first + size, comp_);
+            }
+
+            RandomIt begin_;
+            T* buf_;
+            const KeyOf& key_of_;
+            const Compare& comp_;
+            const RunParallel& run_parallel_;
+    };
+
+    /**
+     * @brief Parallel radix sort by RadixSort.
+     *        Elements of types, which are not trivially copyable, are moved to the scratch buffer first.
+     * @param run_parallel Runs task(0), ..., task(count - 1) of run_parallel(count, task) in parallel and waits.
+     * @return False if the scratch buffer cannot be allocated, the range is untouched then.
+     */
+    template <typename RandomIt, typename KeyOf, typename Compare, typename RunParallel,
+              typename T = typename std::iterator_traits<RandomIt>::value_type,
+              typename diff_t = typename std::iterator_traits<RandomIt>::difference_type>
+    inline bool radix_sort_par(const RandomIt begin, const RandomIt end, const KeyOf& key_of, const Compare& comp,
+                               const int threads, const RunParallel& run_parallel) {
+        const diff_t size = end - begin;
+        const MergeBuffer<T> buffer(size);
+        if (!buffer.data())
+            return false;
+        T* const buf = buffer.data();
+        const RadixSort<RandomIt, KeyOf, Compare, RunParallel> radix(begin, buf, key_of, comp, run_parallel);
+
+        constexpr bool in_buffer = !std::is_trivially_copyable_v<T>;
+        const auto for_chunks = [&](const auto& task) {
+            run_parallel(threads, [&](const int chunk) {
+                task(buf + size * chunk / threads, buf + size * (chunk + 1) / threads, begin + size * chunk / threads);
+            });
+        };
+        if constexpr (in_buffer)
+            for_chunks([](T* const first, T* const last, const RandomIt src) {
+                std::uninitialized_move(src, src + (last - first), first);
+            });
+        if (const int pass = radix.top_pass(0, size, in_buffer, threads); pass >= 0)
+            radix.sort(0, size, pass, in_buffer, threads);
+        else if constexpr (in_buffer)
+            for_chunks([](T* const first, T* const last, const RandomIt dst) { std::move(first, last, dst); });
+        if constexpr (in_buffer)
+            for_chunks([](T* const first, T* const last, RandomIt) { std::destroy(first, last); });
+        return true;
+    }
+
+    /**
+     * @brief Sort the range by radix_sort_par, small ranges are sorted sequentially.
+     * @param run_parallel Runs task(0), ..., task(count - 1) of run_parallel(count, task) in parallel and waits.
+     * @param fallback Called with the equivalent comparator, if the scratch buffer cannot be allocated.
+     */
+    template <typename RandomIt, typename Compare, typename RunParallel, typename Fallback,
+              typename T = typename std::iterator_traits<RandomIt>::value_type,
+              typename diff_t = typename std::iterator_traits<RandomIt>::difference_type>
+    inline void radix_ppqsort(const RandomIt begin, const RandomIt end, const Compare& comp, const int threads,
+                              const RunParallel& run_parallel, const Fallback& fallback) {
+        static_assert(radix_sortable<T, Compare>,
+                      "execution::par_radix needs std::less or std::greater with an integer or float type, "
+                      "or a projection returning an integer or float key.");
+        if (begin == end)
+            return;
+        const auto fallback_comp = radix_fallback_compare<T>(comp);
+        if (end - begin < parameters::radix_threshold)
+            return radix_seq_fallback(begin, end, fallback_comp);
+        if (!radix_sort_par(begin, end, radix_key_of<T, Compare>{comp}, fallback_comp, threads, run_parallel))
+            fallback(fallback_comp);
+    }
+
+    /**
+     * @brief Radix sort on the calling thread, used for inputs too small for the parallel sort.
+     */
+    template <typename RandomIt, typename Compare>
+    inline void seq_radix_ppqsort(const RandomIt begin, const RandomIt end, const Compare& comp) {
+        const auto sequential = [](const int count, const auto& task) {
+            for (int i = 0; i < count; ++i)
+                task(i);
+        };
+        radix_ppqsort(begin, end, comp, 1, sequential, [begin, end](const auto& fallback_comp) {
+            radix_seq_fallback(begin, end, fallback_comp);
+        });
+    }
+}
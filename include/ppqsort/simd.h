@@ -0,0 +1,232 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <type_traits>
+
+#include "parameters.h"
+
+// kernels for x86 instruction sets are always compiled, the one supported by the CPU is selected at runtime
+#if !defined(PPQSORT_NO_SIMD) && (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define PPQSORT_SIMD_DISPATCH 1
+#include <immintrin.h>
+#else
+#define PPQSORT_SIMD_DISPATCH 0
+#endif
+
+// vectors of the network stay in registers only if all its steps are inlined and unrolled
+#if defined(__GNUC__)
+#define PPQSORT_NETWORK_INLINE inline __attribute__((always_inline))
+#define PPQSORT_NETWORK_UNROLL _Pragma("GCC unroll 8")
+#else
+#define PPQSORT_NETWORK_INLINE inline
+#define PPQSORT_NETWORK_UNROLL
+#endif
+
+namespace ppqsort::impl {
+
+    template <typename Compare>
+    struct inverted_compare;
+
+    namespace simd {
+
+    /**
+     * @brief Instruction sets with vectorized kernels.
+     */
+    enum class isa { none, avx2, avx512 };
+
+    /**
+     * @brief Check, if the CPU and OS support the instruction set.
+     */
+    inline bool cpu_supports([[maybe_unused]] const isa set) {
+        #if PPQSORT_SIMD_DISPATCH
+        __builtin_cpu_init();
+        switch (set) {
+            case isa::avx512:
+                return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("popcnt");
+            case isa::avx2:
+                return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+            default:
+                return true;
+        }
+        #else
+        return set == isa::none;
+        #endif
+    }
+
+    /**
+     * @brief Instruction set used by the kernels, the widest one supported by the CPU.
+     *        Selected once at the first use, define PPQSORT_NO_SIMD to use only the scalar code.
+     */
+    inline isa cpu_isa() {
+        #if PPQSORT_SIMD_DISPATCH && defined(__AVX512F__) && defined(__POPCNT__)
+        // the whole program requires AVX-512 already, so the kernels can be inlined
+        return isa::avx512;
+        #else
+        static const isa selected = cpu_supports(isa::avx512) ? isa::avx512
+                                    : cpu_supports(isa::avx2) ? isa::avx2
+                                                              : isa::none;
+        return selected;
+        #endif
+    }
+
+    /**
+     * @brief Width of vector registers in bits used by the kernels, 0 if they are disabled.
+     */
+    inline int width() {
+        switch (cpu_isa()) {
+            case isa::avx512: return 512;
+            case isa::avx2: return 256;
+            default: return 0;
+        }
+    }
+
+    /**
+     * @brief Comparators, which can be evaluated by vector compares on type T.
+     *        comp(a, b) == negated ^ (reversed ? b < a : a < b)
+     */
+    template <typename Compare, typename T>
+    struct vector_compare {
+        static constexpr bool supported = false;
+        static constexpr bool reversed = false;
+        static constexpr bool negated = false;
+    };
+
+    template <typename T>
+    struct vector_compare<std::less<T>, T> {
+        static constexpr bool supported = true;
+        static constexpr bool reversed = false;
+        static constexpr bool negated = false;
+    };
+
+    template <typename T>
+    struct vector_compare<std::less<>, T> : vector_compare<std::less<T>, T> {};
+
+    template <typename T>
+    struct vector_compare<std::ranges::less, T> : vector_compare<std::less<T>, T> {};
+
+    template <typename T>
+    struct vector_compare<std::greater<T>, T> {
+        static constexpr bool supported = true;
+        static constexpr bool reversed = true;
+        static constexpr bool negated = false;
+    };
+
+    template <typename T>
+    struct vector_compare<std::greater<>, T> : vector_compare<std::greater<T>, T> {};
+
+    template <typename T>
+    struct vector_compare<std::ranges::greater, T> : vector_compare<std::greater<T>, T> {};
+
+    // inverted_compare(a, b) == !comp(b, a)
+    template <typename Compare, typename T>
+    struct vector_compare<inverted_compare<Compare>, T> {
+        static constexpr bool supported = vector_compare<Compare, T>::supported;
+        static constexpr bool reversed = !vector_compare<Compare, T>::reversed;
+        static constexpr bool negated = !vector_compare<Compare, T>::negated;
+    };
+
+    /**
+     * @brief Lanes l of a vector with the given bit of l set, as a bit mask.
+     */
+    constexpr unsigned lanes_with_bit(const int lanes, const int bit) {
+        unsigned mask = 0;
+        for (int lane = 0; lane < lanes; ++lane)
+            if (lane & bit)
+                mask |= 1u << lane;
+        return mask;
+    }
+
+    /**
+     * @brief Type of the elements in registers of the sorting network, 8-bit and 16-bit integers are widened.
+     */
+    template <typename T>
+    using network_type = std::conditional_t<std::is_integral_v<T> && sizeof(T) < 4, std::int32_t, T>;
+    }
+}
+
+#if PPQSORT_SIMD_DISPATCH
+#include "simd/avx2.h"
+#include "simd/avx512.h"
+#endif
+
+namespace ppqsort::impl::simd {
+
+    /**
+     * @brief Types with vectorized kernels, 32-bit and 64-bit arithmetic types.
+     */
+    template <typename T>
+    inline constexpr bool vector_type = PPQSORT_SIMD_DISPATCH && std::is_arithmetic_v<T> &&
+                                        !std::is_same_v<T, bool> && (sizeof(T) == 4 || sizeof(T) == 8) &&
+                                        (std::is_integral_v<T> || std::is_same_v<T, float> ||
+                                         std::is_same_v<T, double>);
+
+    /**
+     * @brief Vectorized populate_block is used for contiguous ranges of 32-bit and 64-bit arithmetic types
+     *        with default comparators, if the CPU supports it.
+     */
+    template <typename RandomIt, typename Compare, typename Offset,
+              typename T = typename std::iterator_traits<RandomIt>::value_type>
+    inline constexpr bool enabled = std::contiguous_iterator<RandomIt> && std::is_same_v<Offset, std::uint16_t> &&
+                                    vector_type<T> && vector_compare<std::decay_t<Compare>, T>::supported;
+
+    /**
+     * @brief Sorting network is used for contiguous ranges of arithmetic types with default comparators,
+     *        if the CPU supports vectors of their network_type.
+     */
+    template <typename RandomIt, typename Compare,
+              typename T = typename std::iterator_traits<RandomIt>::value_type>
+    inline constexpr bool network_enabled = std::contiguous_iterator<RandomIt> && std::is_arithmetic_v<T> &&
+                                            !std::is_same_v<T, bool> && vector_type<network_type<T>> &&
+                                            vector_compare<std::decay_t<Compare>, T>::supported &&
+                                            !vector_compare<std::decay_t<Compare>, T>::negated;
+
+    /**
+     * @brief Vectorized populate_block for whole groups of elements, see the kernels for details.
+     * @return Number of processed elements, 0 if the CPU does not support any of the kernels.
+     */
+    template <side s, typename Compare, typename T, typename Offset, typename diff_t>
+    inline int populate_block(const T* data, const T& pivot, Offset* offsets, diff_t& count, const int block_size) {
+        #if PPQSORT_SIMD_DISPATCH
+        switch (cpu_isa()) {
+            case isa::avx512:
+                return avx512::populate_block<s, Compare>(data, pivot, offsets, count, block_size);
+            case isa::avx2:
+                return avx2::populate_block<s, Compare>(data, pivot, offsets, count, block_size);
+            default:
+                break;
+        }
+        #endif
+        return 0;
+    }
+
+    /**
+     * @brief Sort a small range with a vectorized sorting network.
+     * @return false if the range was left untouched, because it is too large, it contains NaNs,
+     *         or the CPU does not support any of the kernels.
+     */
+    template <typename RandomIt, typename Compare,
+              typename T = typename std::iterator_traits<RandomIt>::value_type>
+    inline bool small_sort(RandomIt begin, RandomIt end) {
+        #if PPQSORT_SIMD_DISPATCH
+        constexpr bool descending = vector_compare<std::decay_t<Compare>, T>::reversed;
+        switch (cpu_isa()) {
+            case isa::avx512:
+                return avx512::small_sort<descending>(std::to_address(begin), end - begin);
+            case isa::avx2:
+                return avx2::small_sort<descending>(std::to_address(begin), end - begin);
+            default:
+                break;
+        }
+        #endif
+        return false;
+    }
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+// AVX2 kernels are compiled for AVX2 regardless of the target options and used only on CPUs supporting it
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,popcnt"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2,popcnt")
+#endif
+
+namespace ppqsort::impl::simd::avx2 {
+
+    // operations used by the kernels are listed in kernels.h
+    template <typename T, std::size_t size = sizeof(T), bool floating = std::is_floating_point_v<T>>
+    struct Vector {
+        static constexpr bool supported = false;
+    };
+
+    // offsets of 8 elements are compressed at once
+    inline constexpr int group = 8;
+
+    template <typename T>
+    struct Vector<T, 4, false> {
+        static constexpr bool supported = true;
+        static constexpr int lanes = 8;
+        using type = __m256i;
+        static type broadcast(const T value) { return _mm256_set1_epi32(static_cast<int>(value)); }
+        static type load(const T* data) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data)); }
+        static type reverse(const type v) {
+            return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+        }
+        static unsigned less(type a, type b) {
+            // AVX2 has only signed compares, flipping the sign bit keeps the order of unsigned values
+            if constexpr (!std::is_signed_v<T>) {
+                const __m256i sign = _mm256_set1_epi32(static_cast<int>(0x80000000u));
+                a = _mm256_xor_si256(a, sign);
+                b = _mm256_xor_si256(b, sign);
+            }
+            return static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(b, a))));
+        }
+        static void store(T* data, const type v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(data), v); }
+        static type permute_xor(const type v, const int j) {
+            return _mm256_permutevar8x32_epi32(v, _mm256_xor_si256(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                                                   _mm256_set1_epi32(j)));
+        }
+        static void sort_pair(type& a, type& b) {
+            if constexpr (std::is_signed_v<T>) {
+                const type min = _mm256_min_epi32(a, b);
+                b = _mm256_max_epi32(a, b);
+                a = min;
+            } else {
+                const type min = _mm256_min_epu32(a, b);
+                b = _mm256_max_epu32(a, b);
+                a = min;
+            }
+        }
+        static type select(const type a, const type b, const int bit) {
+            const __m256i bits = _mm256_set1_epi32(bit);
+            const __m256i lanes_set = _mm256_and_si256(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), bits);
+            return _mm256_blendv_epi8(a, b, _mm256_cmpeq_epi32(lanes_set, bits));
+        }
+        static __m256i first_lanes(const int count) {
+            return _mm256_cmpgt_epi32(_mm256_set1_epi32(count), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        }
+        static type load_partial(const T* data, const int count, const T fill) {
+            const __m256i mask = first_lanes(count);
+            return _mm256_blendv_epi8(broadcast(fill), _mm256_maskload_epi32(reinterpret_cast<const int*>(data), mask),
+                                      mask);
+        }
+    };
+
+    template <typename T>
+    struct Vector<T, 8, false> {
+        static constexpr bool supported = true;
+        static constexpr int lanes = 4;
+        using type = __m256i;
+        static type broadcast(const T value) { return _mm256_set1_epi64x(static_cast<long long>(value)); }
+        static type load(const T* data) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data)); }
+        static type reverse(const type v) { return _mm256_permute4x64_epi64(v, 0x1B); }
+        static unsigned less(type a, type b) {
+            if constexpr (!std::is_signed_v<T>) {
+                const __m256i sign = _mm256_set1_epi64x(static_cast<long long>(0x8000000000000000ull));
+                a = _mm256_xor_si256(a, sign);
+                b = _mm256_xor_si256(b, sign);
+            }
+            return static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(b, a))));
+        }
+        static void store(T* data, const type v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(data), v); }
+        static type permute_xor(const type v, const int j) {
+            // 64-bit lane l consists of 32-bit lanes 2l and 2l + 1
+            return _mm256_permutevar8x32_epi32(v, _mm256_xor_si256(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                                                   _mm256_set1_epi32(2 * j)));
+        }
+        static void sort_pair(type& a, type& b) {
+            const __m256i swap = _mm256_cmpgt_epi64(flip_sign(a), flip_sign(b));
+            const type min = _mm256_blendv_epi8(a, b, swap);
+            b = _mm256_blendv_epi8(b, a, swap);
+            a = min;
+        }
+        static type select(const type a, const type b, const int bit) {
+            const __m256i bits = _mm256_set1_epi64x(bit);
+            const __m256i lanes_set = _mm256_and_si256(_mm256_setr_epi64x(0, 1, 2, 3), bits);
+            return _mm256_blendv_epi8(a, b, _mm256_cmpeq_epi64(lanes_set, bits));
+        }
+        static type flip_sign(const type v) {
+            if constexpr (std::is_signed_v<T>)
+                return v;
+            else
+                return _mm256_xor_si256(v, _mm256_set1_epi64x(static_cast<long long>(0x8000000000000000ull)));
+        }
+        static __m256i first_lanes(const int count) {
+            return _mm256_cmpgt_epi64(_mm256_set1_epi64x(count), _mm256_setr_epi64x(0, 1, 2, 3));
+        }
+        static type load_partial(const T* data, const int count, const T fill) {
+            const __m256i mask = first_lanes(count);
+            return _mm256_blendv_epi8(broadcast(fill),
+                                      _mm256_maskload_epi64(reinterpret_cast<const long long*>(data), mask), mask);
+        }
+    };
+
+    template <>
+    struct Vector<float, 4, true> {
+        static constexpr bool supported = true;
+        static constexpr int lanes = 8;
+        using type = __m256;
+        static type broadcast(const float value) { return _mm256_set1_ps(value); }
+        static type load(const float* data) { return _mm256_loadu_ps(data); }
+        static type reverse(const type v) {
+            return _mm256_permutevar8x32_ps(v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+        }
+        // ordered compare, NaN is not less than anything as in the scalar comparison
+        static unsigned less(const type a, const type b) {
+            return static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ)));
+        }
+        static void store(float* data, const type v) { _mm256_storeu_ps(data, v); }
+        static type permute_xor(const type v, const int j) {
+            return _mm256_permutevar8x32_ps(v, _mm256_xor_si256(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                                                _mm256_set1_epi32(j)));
+        }
+        // compare and blend instead of min and max, which do not keep signed zeros
+        static void sort_pair(type& a, type& b) {
+            const type swap = _mm256_cmp_ps(b, a, _CMP_LT_OQ);
+            const type min = _mm256_blendv_ps(a, b, swap);
+            b = _mm256_blendv_ps(b, a, swap);
+            a = min;
+        }
+        static type select(const type a, const type b, const int bit) {
+            const __m256i bits = _mm256_set1_epi32(bit);
+            const __m256i lanes_set = _mm256_and_si256(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), bits);
+            return _mm256_blendv_ps(a, b, _mm256_castsi256_ps(_mm256_cmpeq_epi32(lanes_set, bits)));
+        }
+        static __m256i first_lanes(const int count) {
+            return _mm256_cmpgt_epi32(_mm256_set1_epi32(count), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        }
+        static type load_partial(const float* data, const int count, const float fill) {
+            const __m256i mask = first_lanes(count);
+            return _mm256_blendv_ps(broadcast(fill), _mm256_maskload_ps(data, mask), _mm256_castsi256_ps(mask));
+        }
+    };
+
+    template <>
+    struct Vector<double, 8, true> {
+        static constexpr bool supported = true;
+        static constexpr int lanes = 4;
+        using type = __m256d;
+        static type broadcast(const double value) { return _mm256_set1_pd(value); }
+        static type load(const double* data) { return _mm256_loadu_pd(data); }
+        static type reverse(const type v) { return _mm256_permute4x64_pd(v, 0x1B); }
+        static unsigned less(const type a, const type b) {
+            return static_cast<unsigned>(_mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LT_OQ)));
+        }
+        static void store(double* data, const type v) { _mm256_storeu_pd(data, v); }
+        static type permute_xor(const type v, const int j) {
+            const __m256i indices = _mm256_xor_si256(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                                     _mm256_set1_epi32(2 * j));
+            return _mm256_castsi256_pd(_mm256_permutevar8x32_epi32(_mm256_castpd_si256(v), indices));
+        }
+        static void sort_pair(type& a, type& b) {
+            const type swap = _mm256_cmp_pd(b, a, _CMP_LT_OQ);
+            const type min = _mm256_blendv_pd(a, b, swap);
+            b = _mm256_blendv_pd(b, a, swap);
+            a = min;
+        }
+        static type select(const type a, const type b, const int bit) {
+            const __m256i bits = _mm256_set1_epi64x(bit);
+            const __m256i lanes_set = _mm256_and_si256(_mm256_setr_epi64x(0, 1, 2, 3), bits);
+            return _mm256_blendv_pd(a, b, _mm256_castsi256_pd(_mm256_cmpeq_epi64(lanes_set, bits)));
+        }
+        static __m256i first_lanes(const int count) {
+            return _mm256_cmpgt_epi64(_mm256_set1_epi64x(count), _mm256_setr_epi64x(0, 1, 2, 3));
+        }
+        static type load_partial(const double* data, const int count, const double fill) {
+            const __m256i mask = first_lanes(count);
+            return _mm256_blendv_pd(broadcast(fill), _mm256_maskload_pd(data, mask), _mm256_castsi256_pd(mask));
+        }
+    };
+
+    /**
+     * @brief Positions of set bits for each 8-bit mask, packed to bytes.
+     */
+    inline constexpr std::array<std::uint64_t, 256> compress_table = [] {
+        std::array<std::uint64_t, 256> table{};
+        for (unsigned mask = 0; mask < 256; ++mask) {
+            int count = 0;
+            for (unsigned bit = 0; bit < 8; ++bit)
+                if (mask >> bit & 1)
+                    table[mask] |= static_cast<std::uint64_t>(bit) << (8 * count++);
+        }
+        return table;
+    }();
+
+    /**
+     * @brief Store offsets base + i of set bits i of the mask to offsets, writes all group entries.
+     */
+    template <typename Offset>
+    inline void store_offsets(Offset* offsets, const unsigned mask, const int base) {
+        const __m128i positions = _mm_cvtepu8_epi16(_mm_cvtsi64_si128(static_cast<long long>(compress_table[mask])));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(offsets),
+                         _mm_add_epi16(positions, _mm_set1_epi16(static_cast<short>(base))));
+    }
+
+    #include "kernels.h"
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
@@ -0,0 +1,204 @@
+#pragma once
+
+// AVX-512 kernels are compiled for AVX-512 regardless of the target options and used only on CPUs supporting it
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f,popcnt"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx512f,popcnt")
+#endif
+
+namespace ppqsort::impl::simd::avx512 {
+
+    // operations used by the kernels are listed in kernels.h
+    template <typename T, std::size_t size = sizeof(T), bool floating = std::is_floating_point_v<T>>
+    struct Vector {
+        static constexpr bool supported = false;
+    };
+
+    // all-ones masked forms are used, unmasked ones trigger false uninitialized warnings of GCC
+
+    // offsets of 16 elements are compressed at once
+    inline constexpr int group = 16;
+
+    template <typename T>
+    struct Vector<T, 4, false> {
+        static constexpr bool supported = true;
+        static constexpr int lanes = 16;
+        using type = __m512i;
+        static type broadcast(const T value) { return _mm512_set1_epi32(static_cast<int>(value)); }
+        static type load(const T* data) { return _mm512_loadu_si512(data); }
+        static type reverse(const type v) {
+            return _mm512_maskz_permutexvar_epi32(0xFFFF, _mm512_setr_epi32(15, 14, 13, 12, 11, 10, 9, 8,
+                                                                            7, 6, 5, 4, 3, 2, 1, 0), v);
+        }
+        static unsigned less(const type a, const type b) {
+            if constexpr (std::is_signed_v<T>)
+                return _mm512_cmplt_epi32_mask(a, b);
+            else
+                return _mm512_cmplt_epu32_mask(a, b);
+        }
+        static void store(T* data, const type v) { _mm512_storeu_si512(data, v); }
+        static type permute_xor(const type v, const int j) {
+            const __m512i indices = _mm512_xor_si512(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+                                                                       8, 9, 10, 11, 12, 13, 14, 15),
+                                                     _mm512_set1_epi32(j));
+            return _mm512_maskz_permutexvar_epi32(0xFFFF, indices, v);
+        }
+        static void sort_pair(type& a, type& b) {
+            if constexpr (std::is_signed_v<T>) {
+                const type min = _mm512_maskz_min_epi32(0xFFFF, a, b);
+                b = _mm512_maskz_max_epi32(0xFFFF, a, b);
+                a = min;
+            } else {
+                const type min = _mm512_maskz_min_epu32(0xFFFF, a, b);
+                b = _mm512_maskz_max_epu32(0xFFFF, a, b);
+                a = min;
+            }
+        }
+        static type select(const type a, const type b, const int bit) {
+            return _mm512_mask_blend_epi32(static_cast<__mmask16>(lanes_with_bit(lanes, bit)), a, b);
+        }
+        static unsigned first_lanes(const int count) {
+            return count <= 0 ? 0u : count >= lanes ? 0xFFFFu : (1u << count) - 1;
+        }
+        static type load_partial(const T* data, const int count, const T fill) {
+            return _mm512_mask_loadu_epi32(broadcast(fill), static_cast<__mmask16>(first_lanes(count)), data);
+        }
+    };
+
+    template <typename T>
+    struct Vector<T, 8, false> {
+        static constexpr bool supported = true;
+        static constexpr int lanes = 8;
+        using type = __m512i;
+        static type broadcast(const T value) { return _mm512_set1_epi64(static_cast<long long>(value)); }
+        static type load(const T* data) { return _mm512_loadu_si512(data); }
+        static type reverse(const type v) {
+            return _mm512_maskz_permutexvar_epi64(0xFF, _mm512_setr_epi64(7, 6, 5, 4, 3, 2, 1, 0), v);
+        }
+        static unsigned less(const type a, const type b) {
+            if constexpr (std::is_signed_v<T>)
+                return _mm512_cmplt_epi64_mask(a, b);
+            else
+                return _mm512_cmplt_epu64_mask(a, b);
+        }
+        static void store(T* data, const type v) { _mm512_storeu_si512(data, v); }
+        static type permute_xor(const type v, const int j) {
+            const __m512i indices = _mm512_xor_si512(_mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7), _mm512_set1_epi64(j));
+            return _mm512_maskz_permutexvar_epi64(0xFF, indices, v);
+        }
+        static void sort_pair(type& a, type& b) {
+            if constexpr (std::is_signed_v<T>) {
+                const type min = _mm512_maskz_min_epi64(0xFF, a, b);
+                b = _mm512_maskz_max_epi64(0xFF, a, b);
+                a = min;
+            } else {
+                const type min = _mm512_maskz_min_epu64(0xFF, a, b);
+                b = _mm512_maskz_max_epu64(0xFF, a, b);
+                a = min;
+            }
+        }
+        static type select(const type a, const type b, const int bit) {
+            return _mm512_mask_blend_epi64(static_cast<__mmask8>(lanes_with_bit(lanes, bit)), a, b);
+        }
+        static unsigned first_lanes(const int count) {
+            return count <= 0 ? 0u : count >= lanes ? 0xFFu : (1u << count) - 1;
+        }
+        static type load_partial(const T* data, const int count, const T fill) {
+            return _mm512_mask_loadu_epi64(broadcast(fill), static_cast<__mmask8>(first_lanes(count)), data);
+        }
+    };
+
+    template <>
+    struct Vector<float, 4, true> {
+        static constexpr bool supported = true;
+        static constexpr int lanes = 16;
+        using type = __m512;
+        static type broadcast(const float value) { return _mm512_set1_ps(value); }
+        static type load(const float* data) { return _mm512_loadu_ps(data); }
+        static type reverse(const type v) {
+            return _mm512_maskz_permutexvar_ps(0xFFFF, _mm512_setr_epi32(15, 14, 13, 12, 11, 10, 9, 8,
+                                                                         7, 6, 5, 4, 3, 2, 1, 0), v);
+        }
+        // ordered compare, NaN is not less than anything as in the scalar comparison
+        static unsigned less(const type a, const type b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+        static void store(float* data, const type v) { _mm512_storeu_ps(data, v); }
+        static type permute_xor(const type v, const int j) {
+            const __m512i indices = _mm512_xor_si512(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+                                                                       8, 9, 10, 11, 12, 13, 14, 15),
+                                                     _mm512_set1_epi32(j));
+            return _mm512_maskz_permutexvar_ps(0xFFFF, indices, v);
+        }
+        // compare and blend instead of min and max, which do not keep signed zeros
+        static void sort_pair(type& a, type& b) {
+            const __mmask16 swap = _mm512_cmp_ps_mask(b, a, _CMP_LT_OQ);
+            const type min = _mm512_mask_blend_ps(swap, a, b);
+            b = _mm512_mask_blend_ps(swap, b, a);
+            a = min;
+        }
+        static type select(const type a, const type b, const int bit) {
+            return _mm512_mask_blend_ps(static_cast<__mmask16>(lanes_with_bit(lanes, bit)), a, b);
+        }
+        static unsigned first_lanes(const int count) {
+            return count <= 0 ? 0u : count >= lanes ? 0xFFFFu : (1u << count) - 1;
+        }
+        static type load_partial(const float* data, const int count, const float fill) {
+            return _mm512_mask_loadu_ps(broadcast(fill), static_cast<__mmask16>(first_lanes(count)), data);
+        }
+    };
+
+    template <>
+    struct Vector<double, 8, true> {
+        static constexpr bool supported = true;
+        static constexpr int lanes = 8;
+        using type = __m512d;
+        static type broadcast(const double value) { return _mm512_set1_pd(value); }
+        static type load(const double* data) { return _mm512_loadu_pd(data); }
+        static type reverse(const type v) {
+            return _mm512_maskz_permutexvar_pd(0xFF, _mm512_setr_epi64(7, 6, 5, 4, 3, 2, 1, 0), v);
+        }
+        static unsigned less(const type a, const type b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+        static void store(double* data, const type v) { _mm512_storeu_pd(data, v); }
+        static type permute_xor(const type v, const int j) {
+            const __m512i indices = _mm512_xor_si512(_mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7), _mm512_set1_epi64(j));
+            return _mm512_maskz_permutexvar_pd(0xFF, indices, v);
+        }
+        static void sort_pair(type& a, type& b) {
+            const __mmask8 swap = _mm512_cmp_pd_mask(b, a, _CMP_LT_OQ);
+            const type min = _mm512_mask_blend_pd(swap, a, b);
+            b = _mm512_mask_blend_pd(swap, b, a);
+            a = min;
+        }
+        static type select(const type a, const type b, const int bit) {
+            return _mm512_mask_blend_pd(static_cast<__mmask8>(lanes_with_bit(lanes, bit)), a, b);
+        }
+        static unsigned first_lanes(const int count) {
+            return count <= 0 ? 0u : count >= lanes ? 0xFFu : (1u << count) - 1;
+        }
+        static type load_partial(const double* data, const int count, const double fill) {
+            return _mm512_mask_loadu_pd(broadcast(fill), static_cast<__mmask8>(first_lanes(count)), data);
+        }
+    };
+
+    /**
+     * @brief Store offsets base + i of set bits i of the mask to offsets, writes all group entries.
+     */
+    template <typename Offset>
+    inline void store_offsets(Offset* offsets, const unsigned mask, const int base) {
+        const __m512i indices = _mm512_add_epi32(_mm512_set1_epi32(base),
+                                                 _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+                                                                   8, 9, 10, 11, 12, 13, 14, 15));
+        const __m512i compressed = _mm512_maskz_compress_epi32(static_cast<__mmask16>(mask), indices);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(offsets), _mm512_maskz_cvtepi32_epi16(0xFFFF, compressed));
+    }
+
+    #include "kernels.h"
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
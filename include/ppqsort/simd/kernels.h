@@ -0,0 +1,169 @@
+// Kernels generic over Vector, included once per instruction set inside its namespace, so there is no include guard.
+// The instruction set declares before them:
+//   Vector<T> with operations on 32-bit and 64-bit arithmetic types:
+//     less(a, b) returns bit mask of lanes, where a < b,
+//     sort_pair(a, b) moves lane minimums to a and maximums to b, permute_xor(v, j) moves lane l ^ j to lane l,
+//     select(a, b, bit) takes lanes l with the bit of l set from b, other lanes from a,
+//     load_partial reads only the first count lanes, other lanes are set to fill,
+//   group, the number of elements processed at once by populate_block,
+//   store_offsets(offsets, mask, base), which stores offsets base + i of set bits i of the mask.
+
+    /**
+     * @brief Vectorized version of populate_block for whole groups of elements.
+     *        Element i of the block is data[i] for the left side and data[-i] for the right side.
+     *        Offsets buffer must hold block_size entries, entries after the count can be overwritten.
+     * @return Number of processed elements, the rest of the block is left to the scalar loop.
+     */
+    template <side s, typename Compare, typename T, typename Offset, typename diff_t>
+    inline int populate_block(const T* data, const T& pivot, Offset* offsets, diff_t& count, const int block_size) {
+        using V = Vector<T>;
+        using traits = vector_compare<std::decay_t<Compare>, T>;
+        constexpr int vectors = group / V::lanes;
+        const typename V::type p = V::broadcast(pivot);
+        int i = 0;
+        for (; i + group <= block_size; i += group) {
+            unsigned mask = 0;
+            for (int v = 0; v < vectors; ++v) {
+                const typename V::type x = s == left ? V::load(data + i + v * V::lanes)
+                                                     : V::reverse(V::load(data - (i + (v + 1) * V::lanes - 1)));
+                mask |= (traits::reversed ? V::less(p, x) : V::less(x, p)) << (v * V::lanes);
+            }
+            // mask holds comp(x, pivot) without negation, left side collects elements not less than the pivot
+            if constexpr ((s == left) != traits::negated)
+                mask ^= (1u << group) - 1;
+            // count <= i, so the group fits into the block
+            store_offsets(offsets + count, mask, i);
+            count += std::popcount(mask);
+        }
+        return i;
+    }
+
+    /**
+     * @brief Compare-exchange of elements i and i ^ distance of the registers,
+     *        the one with the bit of its index unset gets the minimum.
+     */
+    template <typename V, int registers, int distance, int bit>
+    PPQSORT_NETWORK_INLINE void compare_exchange(typename V::type (&v)[registers]) {
+        constexpr int lanes = V::lanes;
+        if constexpr (bit < lanes) {
+            PPQSORT_NETWORK_UNROLL
+            for (int r = 0; r < registers; ++r) {
+                typename V::type min = v[r];
+                typename V::type max = V::permute_xor(v[r], distance);
+                V::sort_pair(min, max);
+                v[r] = V::select(min, max, bit);
+            }
+        } else {
+            // distance is either a multiple of lanes, or it also flips all the lanes
+            constexpr int reg_distance = distance / lanes;
+            constexpr int reg_bit = bit / lanes;
+            PPQSORT_NETWORK_UNROLL
+            for (int r = 0; r < registers; ++r) {
+                if (r & reg_bit)
+                    continue;
+                if constexpr (distance % lanes == 0) {
+                    V::sort_pair(v[r], v[r ^ reg_distance]);
+                } else {
+                    typename V::type reversed = V::permute_xor(v[r ^ reg_distance], lanes - 1);
+                    V::sort_pair(v[r], reversed);
+                    v[r ^ reg_distance] = V::permute_xor(reversed, lanes - 1);
+                }
+            }
+        }
+    }
+
+    template <typename V, int registers, int distance>
+    PPQSORT_NETWORK_INLINE void bitonic_merge(typename V::type (&v)[registers]) {
+        compare_exchange<V, registers, distance, distance>(v);
+        if constexpr (distance > 1)
+            bitonic_merge<V, registers, distance / 2>(v);
+    }
+
+    /**
+     * @brief Bitonic sort of registers * lanes elements, element i is lane i % lanes of register i / lanes.
+     *        Both halves are sorted ascending, the first step compares them in opposite directions,
+     *        which makes every step sort in the same direction.
+     */
+    template <typename V, int registers, int k = 2>
+    PPQSORT_NETWORK_INLINE void bitonic_sort(typename V::type (&v)[registers]) {
+        compare_exchange<V, registers, k - 1, k / 2>(v);
+        if constexpr (k >= 4)
+            bitonic_merge<V, registers, k / 4>(v);
+        if constexpr (k < registers * V::lanes)
+            bitonic_sort<V, registers, 2 * k>(v);
+    }
+
+    /**
+     * @brief Sort size elements of keys with a bitonic sort in registers.
+     *        Missing elements are padded with values, which are sorted after all the others.
+     *        Descending order is obtained by sorting ascending with minimal padding and reversing the registers.
+     */
+    template <typename V, int registers, bool descending, typename U>
+    inline void sort_registers(U* keys, const int size) {
+        constexpr int lanes = V::lanes;
+        constexpr U padding = std::is_floating_point_v<U> ?
+                                  (descending ? -std::numeric_limits<U>::infinity()
+                                              : std::numeric_limits<U>::infinity())
+                                  : (descending ? std::numeric_limits<U>::lowest() : std::numeric_limits<U>::max());
+        typename V::type v[registers];
+        PPQSORT_NETWORK_UNROLL
+        for (int r = 0; r < registers; ++r)
+            v[r] = V::load_partial(keys + r * lanes, size - r * lanes, padding);
+        bitonic_sort<V, registers>(v);
+        PPQSORT_NETWORK_UNROLL
+        for (int r = 0; r < registers; ++r) {
+            const typename V::type sorted = descending ? V::reverse(v[registers - 1 - r]) : v[r];
+            const int count = size - r * lanes;
+            if (count >= lanes) {
+                V::store(keys + r * lanes, sorted);
+            } else if (count > 0) {
+                // masked store would stall loads of the following elements, which are often sorted next
+                alignas(64) U rest[lanes];
+                V::store(rest, sorted);
+                std::copy(rest, rest + count, keys + r * lanes);
+            }
+        }
+    }
+
+    template <typename V, bool descending, typename U>
+    inline void sort_keys(U* keys, const int size) {
+        switch (std::bit_ceil(static_cast<unsigned>((size + V::lanes - 1) / V::lanes))) {
+            case 1: sort_registers<V, 1, descending>(keys, size); break;
+            case 2: sort_registers<V, 2, descending>(keys, size); break;
+            case 4: sort_registers<V, 4, descending>(keys, size); break;
+            default: sort_registers<V, 8, descending>(keys, size); break;
+        }
+    }
+
+    /**
+     * @brief Sort a small range of arithmetic type with a sorting network in up to 8 registers.
+     *        Elements of 8-bit and 16-bit types are widened in a temporary buffer.
+     * @return false if the range was left untouched, because it is too large or it contains NaNs.
+     */
+    template <bool descending, typename T>
+    inline bool small_sort(T* data, const std::ptrdiff_t length) {
+        using U = network_type<T>;
+        using V = Vector<U>;
+        constexpr int max_size = 8 * V::lanes;
+        if (length > max_size)
+            return false;
+        const auto size = static_cast<int>(length);
+
+        if constexpr (std::is_floating_point_v<T>) {
+            bool nan = false;
+            for (int i = 0; i < size; ++i)
+                nan |= std::isnan(data[i]);
+            if (nan)
+                return false;
+        }
+
+        if constexpr (std::is_same_v<T, U>) {
+            sort_keys<V, descending>(data, size);
+        } else {
+            alignas(64) U keys[max_size];
+            std::copy(data, data + size, keys);
+            sort_keys<V, descending>(keys, size);
+            std::copy(keys, keys + size, data);
+        }
+        return true;
+    }
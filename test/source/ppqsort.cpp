@@ -2,8 +2,15 @@
 #include <gmock/gmock.h>
 #include <ppqsort.h>
 
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <latch>
 #include <random>
+#include <string>
 #include <limits>
+#include <memory>
+#include <thread>
 
 
 /****************************************************
@@ -84,11 +91,341 @@ TEST(StaticInputs, EmptyContainer) {
     std::vector<int> in = {};
     ppqsort::sort(ppqsort::execution::par, in.begin(), in.end());
     ppqsort::sort(ppqsort::execution::seq, in.begin(), in.end());
+    ppqsort::sort(ppqsort::execution::par_radix, in.begin(), in.end());
     ASSERT_THAT(in, ::testing::ContainerEq(std::vector<int>{}));
 }
 
+// elements equal to the pivot must end up on the left, parallel partitions are used only for big inputs
+template <typename PartitionLeft>
+void check_partition_to_left(PartitionLeft partition_left) {
+    std::mt19937 rng(std::random_device{}());
+    for (const std::size_t size : {std::size_t{20}, std::size_t{1'000'000}}) {
+        for (const bool branchless : {false, true}) {
+            std::vector<int> in(size);
+            std::ranges::generate(in, [&] { return static_cast<int>(rng() % 8); });
+            std::vector ref(in);
+            const int pivot = in.front();
+            const auto pivot_pos = partition_left(in.begin(), in.end(), branchless);
+            ASSERT_EQ(*pivot_pos, pivot);
+            ASSERT_TRUE(std::all_of(in.begin(), pivot_pos + 1, [&](const int i) { return i <= pivot; }));
+            ASSERT_TRUE(std::all_of(pivot_pos + 1, in.end(), [&](const int i) { return i > pivot; }));
+            std::sort(in.begin(), in.end());
+            std::sort(ref.begin(), ref.end());
+            ASSERT_THAT(in, ::testing::ContainerEq(ref));
+        }
+    }
+}
+
+// three-way partition must split the range to <, == and > parts, pivot is chosen as in the main loop
+template <typename PartitionThreeWay>
+void check_partition_three_way(PartitionThreeWay partition_three_way) {
+    std::mt19937 rng(std::random_device{}());
+    for (const std::size_t size : {std::size_t{100}, std::size_t{1'000'000}}) {
+        for (const bool branchless : {false, true}) {
+            std::vector<int> in(size);
+            std::ranges::generate(in, [&] { return static_cast<int>(rng() % 8); });
+            std::vector ref(in);
+            ppqsort::impl::choose_pivot<false>(in.begin(), in.end(), in.end() - in.begin(), std::less<>());
+            const int pivot = in.front();
+            const auto [eq_begin, eq_end] = partition_three_way(in.begin(), in.end(), branchless);
+            ASSERT_LT(eq_begin, eq_end);
+            ASSERT_TRUE(std::all_of(in.begin(), eq_begin, [&](const int i) { return i < pivot; }));
+            ASSERT_TRUE(std::all_of(eq_begin, eq_end, [&](const int i) { return i == pivot; }));
+            ASSERT_TRUE(std::all_of(eq_end, in.end(), [&](const int i) { return i > pivot; }));
+            std::sort(in.begin(), in.end());
+            std::sort(ref.begin(), ref.end());
+            ASSERT_THAT(in, ::testing::ContainerEq(ref));
+        }
+    }
+}
+
+// merge sort replaces heapsort in the parallel loop, it must handle any type, small ranges fall back to heapsort
+template <typename MergeSort>
+void check_merge_sort(MergeSort merge_sort) {
+    std::mt19937 rng(std::random_device{}());
+    for (const std::size_t size : {std::size_t{1000}, std::size_t{1'000'003}}) {
+        for (const int threads : {3, 4}) {
+            std::vector<int> in(size);
+            std::ranges::generate(in, [&] { return static_cast<int>(rng() % 1000); });
+            std::vector ref(in);
+            merge_sort(in.begin(), in.end(), std::less<>(), threads);
+            std::sort(ref.begin(), ref.end());
+            ASSERT_THAT(in, ::testing::ContainerEq(ref));
+
+            std::vector<std::string> in_str(size / 4);
+            std::ranges::generate(in_str, [&] { return std::to_string(rng()); });
+            std::vector ref_str(in_str);
+            merge_sort(in_str.begin(), in_str.end(), std::less<>(), threads);
+            std::sort(ref_str.begin(), ref_str.end());
+            ASSERT_THAT(in_str, ::testing::ContainerEq(ref_str));
+
+            // move only type without default constructor
+            std::vector<std::unique_ptr<int>> in_ptr(size);
+            std::ranges::generate(in_ptr, [&] { return std::make_unique<int>(static_cast<int>(rng())); });
+            merge_sort(in_ptr.begin(), in_ptr.end(), [](const auto& a, const auto& b) { return *a < *b; }, threads);
+            ASSERT_TRUE(std::is_sorted(in_ptr.begin(), in_ptr.end(), [](const auto& a, const auto& b) { return *a < *b; }));
+        }
+    }
+}
+
+TEST(StaticInputs, ParCleanup) {
+    // whole range after the pivot is the dirty segment, tasks run in reverse order to catch dependencies between them
+    const auto run_reversed = [](const int count, const auto& task) {
+        for (int i = count - 1; i >= 0; --i)
+            task(i);
+    };
+    std::mt19937 rng(std::random_device{}());
+    for (const std::ptrdiff_t size : {std::ptrdiff_t{1000}, std::ptrdiff_t{300'001}}) {
+        for (const int unique : {1, 3, 1000}) {
+            for (const bool branchless : {false, true}) {
+                std::vector<int> in(size);
+                std::ranges::generate(in, [&] { return static_cast<int>(rng() % unique); });
+                std::vector ref(in);
+                const int pivot = in.front();
+                const auto [pivot_pos, already_partitioned] = branchless
+                    ? ppqsort::impl::par_cleanup<true>(in.begin(), pivot, std::less<>(), std::ptrdiff_t{1},
+                                                       size - 1, true, 8, run_reversed)
+                    : ppqsort::impl::par_cleanup<false>(in.begin(), pivot, std::less<>(), std::ptrdiff_t{1},
+                                                        size - 1, true, 8, run_reversed);
+                ASSERT_EQ(*pivot_pos, pivot);
+                ASSERT_TRUE(std::all_of(in.begin(), pivot_pos, [&](const int i) { return i < pivot; }));
+                ASSERT_TRUE(std::all_of(pivot_pos, in.end(), [&](const int i) { return i >= pivot; }));
+                ASSERT_EQ(already_partitioned, std::is_partitioned(ref.begin() + 1, ref.end(),
+                                                                   [&](const int i) { return i < pivot; }));
+                std::sort(in.begin(), in.end());
+                std::sort(ref.begin(), ref.end());
+                ASSERT_THAT(in, ::testing::ContainerEq(ref));
+            }
+        }
+    }
+}
+
+// vectorized kernels must produce the same offsets as the scalar loop, on both sides and for any block size
+template <typename T, typename Compare>
+void check_populate_block(Compare comp) {
+    using ppqsort::impl::side;
+    constexpr int buffer_size = ppqsort::parameters::buffer_size;
+    std::mt19937 rng(std::random_device{}());
+    // negative values of unsigned types wrap around, so the highest bit is used too
+    std::vector<T> in(2 * buffer_size);
+    std::ranges::generate(in, [&] { return static_cast<T>(static_cast<int>(rng() % 64) - 32); });
+    if constexpr (std::is_floating_point_v<T>)
+        in[5] = in[in.size() - 7] = std::numeric_limits<T>::quiet_NaN();
+    const T pivot = static_cast<T>(3);
+    for (const int block_size : {buffer_size, 1000, 7}) {
+        for (const side s : {side::left, side::right}) {
+            ppqsort::parameters::buffer_type offsets[buffer_size];
+            std::vector<ppqsort::parameters::buffer_type> expected;
+            const std::ptrdiff_t first = s == side::left ? 0 : static_cast<std::ptrdiff_t>(in.size()) - 1;
+            for (int i = 0; i < block_size; ++i) {
+                const T& elem = in[s == side::left ? first + i : first - i];
+                if (s == side::left ? !comp(elem, pivot) : comp(elem, pivot))
+                    expected.push_back(static_cast<ppqsort::parameters::buffer_type>(i));
+            }
+            auto begin = in.begin();
+            std::ptrdiff_t offset = first, count = 0;
+            if (s == side::left)
+                ppqsort::impl::populate_block<side::left>(begin, offset, pivot, offsets, count, comp, block_size);
+            else
+                ppqsort::impl::populate_block<side::right>(begin, offset, pivot, offsets, count, comp, block_size);
+            ASSERT_EQ(offset, s == side::left ? first + block_size : first - block_size);
+            ASSERT_THAT(std::vector(offsets, offsets + count), ::testing::ContainerEq(expected));
+        }
+    }
+}
+
+template <typename T>
+void check_populate_block() {
+    check_populate_block<T>(std::less<>());
+    check_populate_block<T>(std::greater<T>());
+    // used by parallel partition to the left
+    check_populate_block<T>(ppqsort::impl::inverted_compare<std::less<T>>{});
+}
+
+TEST(StaticInputs, PopulateBlock) {
+    check_populate_block<short>();
+    check_populate_block<int>();
+    check_populate_block<unsigned>();
+    check_populate_block<std::int64_t>();
+    check_populate_block<std::uint64_t>();
+    check_populate_block<float>();
+    check_populate_block<double>();
+}
+
+// sorting network of the base case must agree with std::sort, including extreme values and padding
+template <typename T, typename Compare>
+void check_small_sort(Compare comp) {
+    using iterator = typename std::vector<T>::iterator;
+    std::mt19937 rng(std::random_device{}());
+    const std::vector<T> extremes = {std::numeric_limits<T>::lowest(), std::numeric_limits<T>::max(),
+                                     std::numeric_limits<T>::min(), static_cast<T>(0)};
+    for (int size = 0; size <= ppqsort::parameters::insertion_threshold_primitive; ++size) {
+        std::vector<T> in(static_cast<std::size_t>(size));
+        std::ranges::generate(in, [&] {
+            return rng() % 4 == 0 ? extremes[rng() % extremes.size()] : static_cast<T>(rng() % 16);
+        });
+        if constexpr (std::is_floating_point_v<T>) {
+            if (size > 2) {
+                in[0] = std::numeric_limits<T>::infinity();
+                in[1] = static_cast<T>(-0.0);
+            }
+        }
+        std::vector<T> expected = in;
+        std::sort(expected.begin(), expected.end(), comp);
+        if constexpr (ppqsort::impl::simd::network_enabled<iterator, Compare>) {
+            ASSERT_TRUE((ppqsort::impl::simd::small_sort<iterator, Compare>(in.begin(), in.end())));
+            ASSERT_THAT(in, ::testing::ContainerEq(expected));
+            if constexpr (std::is_floating_point_v<T>) {
+                // ranges with NaNs are left to the insertion sort
+                if (size > 0) {
+                    in[static_cast<std::size_t>(size) / 2] = std::numeric_limits<T>::quiet_NaN();
+                    const std::vector<T> with_nan = in;
+                    ASSERT_FALSE((ppqsort::impl::simd::small_sort<iterator, Compare>(in.begin(), in.end())));
+                    ASSERT_TRUE(std::equal(in.begin(), in.end(), with_nan.begin(), with_nan.end(),
+                                           [](const T a, const T b) { return a == b || (a != a && b != b); }));
+                }
+            }
+        } else {
+            ppqsort::sort(ppqsort::execution::seq, in.begin(), in.end(), comp);
+            ASSERT_THAT(in, ::testing::ContainerEq(expected));
+        }
+    }
+}
+
+template <typename T>
+void check_small_sort() {
+    for (int repeat = 0; repeat < 20; ++repeat) {
+        check_small_sort<T>(std::less<>());
+        check_small_sort<T>(std::greater<T>());
+    }
+}
+
+TEST(StaticInputs, SmallSort) {
+    check_small_sort<char>();
+    check_small_sort<unsigned char>();
+    check_small_sort<short>();
+    check_small_sort<std::uint16_t>();
+    check_small_sort<int>();
+    check_small_sort<unsigned>();
+    check_small_sort<std::int64_t>();
+    check_small_sort<std::uint64_t>();
+    check_small_sort<float>();
+    check_small_sort<double>();
+}
+
+#if PPQSORT_SIMD_DISPATCH
+// kernels of every instruction set supported by the CPU are checked, not only the selected one
+template <ppqsort::impl::simd::isa set, typename T>
+void check_simd_kernels() {
+    namespace simd = ppqsort::impl::simd;
+    using ppqsort::impl::side;
+    if (!simd::cpu_supports(set))
+        return;
+    const auto populate_block = [](auto&&... args) {
+        if constexpr (set == simd::isa::avx512)
+            return simd::avx512::populate_block<side::left, std::less<T>>(args...);
+        else
+            return simd::avx2::populate_block<side::left, std::less<T>>(args...);
+    };
+    const auto small_sort = []<bool descending>(std::vector<T>& data) {
+        if constexpr (set == simd::isa::avx512)
+            return simd::avx512::small_sort<descending>(data.data(), std::ssize(data));
+        else
+            return simd::avx2::small_sort<descending>(data.data(), std::ssize(data));
+    };
+
+    constexpr int buffer_size = ppqsort::parameters::buffer_size;
+    std::mt19937 rng(std::random_device{}());
+    std::vector<T> in(buffer_size);
+    std::ranges::generate(in, [&] { return static_cast<T>(static_cast<int>(rng() % 64) - 32); });
+
+    const T pivot = static_cast<T>(3);
+    ppqsort::parameters::buffer_type offsets[buffer_size];
+    std::ptrdiff_t count = 0;
+    ASSERT_EQ(populate_block(in.data(), pivot, offsets, count, buffer_size), buffer_size);
+    std::vector<ppqsort::parameters::buffer_type> expected;
+    for (int i = 0; i < buffer_size; ++i)
+        if (!(in[static_cast<std::size_t>(i)] < pivot))
+            expected.push_back(static_cast<ppqsort::parameters::buffer_type>(i));
+    ASSERT_THAT(std::vector(offsets, offsets + count), ::testing::ContainerEq(expected));
+
+    for (int size = 0; size <= ppqsort::parameters::insertion_threshold_primitive; ++size) {
+        std::vector<T> ascending(in.begin(), in.begin() + size);
+        std::vector<T> descending = ascending;
+        std::vector<T> sorted = ascending;
+        std::sort(sorted.begin(), sorted.end());
+        ASSERT_TRUE(small_sort.template operator()<false>(ascending));
+        ASSERT_THAT(ascending, ::testing::ContainerEq(sorted));
+        ASSERT_TRUE(small_sort.template operator()<true>(descending));
+        ASSERT_TRUE(std::ranges::equal(descending, sorted | std::views::reverse));
+    }
+}
+
+template <typename T>
+void check_simd_kernels() {
+    check_simd_kernels<ppqsort::impl::simd::isa::avx2, T>();
+    check_simd_kernels<ppqsort::impl::simd::isa::avx512, T>();
+}
+
+TEST(StaticInputs, SimdDispatch) {
+    using ppqsort::impl::simd::isa;
+    const isa selected = ppqsort::impl::simd::cpu_isa();
+    ASSERT_TRUE(ppqsort::impl::simd::cpu_supports(selected));
+    // the widest supported instruction set is selected
+    if (ppqsort::impl::simd::cpu_supports(isa::avx512)) {
+        ASSERT_EQ(selected, isa::avx512);
+    }
+    check_simd_kernels<int>();
+    check_simd_kernels<unsigned>();
+    check_simd_kernels<std::int64_t>();
+    check_simd_kernels<std::uint64_t>();
+    check_simd_kernels<float>();
+    check_simd_kernels<double>();
+}
+#endif
+
+TEST(StaticInputs, MergePathSplit) {
+    const std::vector<int> a = {1, 3, 3, 5, 7};
+    const std::vector<int> b = {2, 3, 4, 8};
+    std::vector<int> merged;
+    std::merge(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(merged));
+    for (std::ptrdiff_t diag = 0; diag <= static_cast<std::ptrdiff_t>(merged.size()); ++diag) {
+        const auto from_a = ppqsort::impl::merge_path_split(a.begin(), std::ptrdiff_t{5}, b.begin(), std::ptrdiff_t{4},
+                                                           diag, std::less<>());
+        std::vector<int> prefix(a.begin(), a.begin() + from_a);
+        prefix.insert(prefix.end(), b.begin(), b.begin() + (diag - from_a));
+        std::sort(prefix.begin(), prefix.end());
+        ASSERT_TRUE(std::equal(prefix.begin(), prefix.end(), merged.begin()));
+        // ties are taken from the first run
+        if (diag == 3) {
+            ASSERT_EQ(from_a, 2);
+        }
+    }
+}
+
 #ifdef _OPENMP
 
+TEST(StaticInputs, MergeSortPar) {
+    check_merge_sort([](auto begin, auto end, auto comp, const int threads) {
+        ppqsort::impl::openmp::merge_sort_par<decltype(begin), decltype(comp), false>(begin, end, comp, threads);
+    });
+}
+
+TEST(StaticInputs, PartitionThreeWayPar) {
+    check_partition_three_way([](auto begin, auto end, const bool branchless) {
+        return branchless
+               ? ppqsort::impl::openmp::partition_three_way_par<true>(begin, end, std::less<>(), 4)
+               : ppqsort::impl::openmp::partition_three_way_par<false>(begin, end, std::less<>(), 4);
+    });
+}
+
+TEST(StaticInputs, PartitionToLeftPar) {
+    check_partition_to_left([](auto begin, auto end, const bool branchless) {
+        return branchless ? ppqsort::impl::openmp::partition_left_branchless_par(begin, end, std::less<>(), 4)
+                          : ppqsort::impl::openmp::partition_to_left_par(begin, end, std::less<>(), 4);
+    });
+}
+
 TEST(StaticInputs, TriggerSeqPartition) {
     std::vector<int> in = {52, 0, 5, 1, 2, 3, 45, 8, 1, 10,
                            52, 0, 5, 1, 2, 3, 45, 8, 1, 10};
@@ -102,6 +439,34 @@ TEST(StaticInputs, TriggerSeqPartition) {
 }
 
 #else
+TEST(StaticInputs, MergeSortPar) {
+    ppqsort::impl::cpp::ThreadPool<> threadpool(3);
+    check_merge_sort([&](auto begin, auto end, auto comp, const int threads) {
+        // called from the parallel loop, so it runs in the pool
+        threadpool.run_and_wait([&] {
+            ppqsort::impl::cpp::merge_sort_par<decltype(begin), decltype(comp), false>(begin, end, comp, threads,
+                                                                                        threadpool);
+        });
+    });
+}
+
+TEST(StaticInputs, PartitionThreeWayPar) {
+    ppqsort::impl::cpp::ThreadPool<> threadpool(3);
+    check_partition_three_way([&](auto begin, auto end, const bool branchless) {
+        return branchless
+               ? ppqsort::impl::cpp::partition_three_way_par<true>(begin, end, std::less<>(), 4, threadpool)
+               : ppqsort::impl::cpp::partition_three_way_par<false>(begin, end, std::less<>(), 4, threadpool);
+    });
+}
+
+TEST(StaticInputs, PartitionToLeftPar) {
+    ppqsort::impl::cpp::ThreadPool<> threadpool(3);
+    check_partition_to_left([&](auto begin, auto end, const bool branchless) {
+        return branchless ? ppqsort::impl::cpp::partition_left_branchless_par(begin, end, std::less<>(), 4, threadpool)
+                          : ppqsort::impl::cpp::partition_to_left_par(begin, end, std::less<>(), 4, threadpool);
+    });
+}
+
 TEST(StaticInputs, TriggerSeqPartition) {
     std::vector<int> in = {52, 0, 5, 1, 2, 3, 45, 8, 1, 10,
                            52, 0, 5, 1, 2, 3, 45, 8, 1, 10};
@@ -149,6 +514,81 @@ TEST(Patterns, Constant) {
     }
 }
 
+TEST(Patterns, FewUnique) {
+    // repeated pivots partition equal elements to the left in parallel
+    std::mt19937 rng(std::random_device{}());
+    for (const int unique : {2, 5, 16}) {
+        std::vector<int> in(static_cast<std::size_t>(4e6));
+        std::ranges::generate(in, [&] { return static_cast<int>(rng() % unique); });
+        std::vector<int> ref(in);
+        ppqsort::sort(ppqsort::execution::par, in.begin(), in.end(), 4);
+        std::sort(ref.begin(), ref.end());
+        ASSERT_THAT(in, ::testing::ContainerEq(ref));
+        std::vector<std::string> in_str(in.size() / 8);
+        std::ranges::generate(in_str, [&] { return std::to_string(rng() % unique); });
+        std::vector<std::string> ref_str(in_str);
+        ppqsort::sort(ppqsort::execution::par, in_str.begin(), in_str.end(), 4);
+        std::sort(ref_str.begin(), ref_str.end());
+        ASSERT_THAT(in_str, ::testing::ContainerEq(ref_str));
+    }
+}
+
+TEST(Patterns, HeavyKey) {
+    // one key fills a big part of the input, three-way partition skips it in the recursion
+    std::mt19937 rng(std::random_device{}());
+    for (const int percent : {30, 60, 95}) {
+        std::vector<int> in(static_cast<std::size_t>(4e6));
+        std::ranges::generate(in, [&] { return static_cast<int>(rng() % 100) < percent ? 42 : static_cast<int>(rng()); });
+        std::vector<int> ref(in);
+        ppqsort::sort(ppqsort::execution::par, in.begin(), in.end(), 4);
+        std::sort(ref.begin(), ref.end());
+        ASSERT_THAT(in, ::testing::ContainerEq(ref));
+    }
+}
+
+TEST(Patterns, RadixKeys) {
+    // negative zero, infinities and denormals keep the order of std::less
+    std::mt19937 rng(std::random_device{}());
+    const double specials[] = {-0.0, 0.0, std::numeric_limits<double>::infinity(),
+                               -std::numeric_limits<double>::infinity(), std::numeric_limits<double>::denorm_min(),
+                               -std::numeric_limits<double>::denorm_min(), std::numeric_limits<double>::lowest()};
+    std::vector<double> in(static_cast<std::size_t>(1e6));
+    std::ranges::generate(in, [&] {
+        return rng() % 4 == 0 ? specials[rng() % std::size(specials)] : std::ldexp(static_cast<double>(rng()) - 2e9, rng() % 64 - 32);
+    });
+    std::vector<double> ref(in);
+    ppqsort::sort(ppqsort::execution::par_radix, in.begin(), in.end(), 4);
+    std::sort(ref.begin(), ref.end());
+    ASSERT_TRUE(std::ranges::equal(in, ref, [](const double a, const double b) { return a == b; }));
+
+    // one key fills most of the input, its bucket is sorted by all threads
+    std::vector<std::uint64_t> heavy(static_cast<std::size_t>(4e6));
+    std::ranges::generate(heavy, [&] { return rng() % 100 < 90 ? rng() % 1000 : (std::uint64_t{rng()} << 32) | rng(); });
+    std::vector<std::uint64_t> heavy_ref(heavy);
+    ppqsort::sort(ppqsort::execution::par_radix, heavy.begin(), heavy.end(), 4);
+    std::sort(heavy_ref.begin(), heavy_ref.end());
+    ASSERT_THAT(heavy, ::testing::ContainerEq(heavy_ref));
+
+    // composite key packed to 64 bits, elements are not trivially copyable
+    std::vector<std::pair<std::pair<int, float>, std::string>> records(static_cast<std::size_t>(5e5));
+    std::ranges::generate(records, [&] {
+        return std::make_pair(std::make_pair(static_cast<int>(rng() % 100) - 50, static_cast<float>(rng() % 1000) / 7.0f - 50.0f),
+                              std::to_string(rng()));
+    });
+    std::vector<std::pair<std::pair<int, float>, std::string>> records_ref(records);
+    const auto key = [](const auto& record) {
+        return (std::uint64_t{ppqsort::radix_key(record.first.first)} << 32) | ppqsort::radix_key(record.first.second);
+    };
+    ppqsort::sort(ppqsort::execution::par_radix, records.begin(), records.end(), key, 4);
+    std::stable_sort(records_ref.begin(), records_ref.end(),
+                     [](const auto& a, const auto& b) { return a.first < b.first; });
+    for (std::size_t i = 0; i < records.size(); ++i)
+        ASSERT_EQ(records[i].first, records_ref[i].first);
+    std::ranges::sort(records);
+    std::ranges::sort(records_ref);
+    ASSERT_THAT(records, ::testing::ContainerEq(records_ref));
+}
+
 TEST(Patterns, HalfSorted) {
     for (auto const & size: sizes) {
         std::vector<int> in(size);
@@ -200,6 +640,219 @@ TEST(Patterns, Adversary) {
 }
 
 
+TEST(Concurrency, ProportionalThreadSplit) {
+    using ppqsort::impl::split_threads;
+    ASSERT_EQ(split_threads(6, 90l, 10l), std::make_pair(5, 1));
+    ASSERT_EQ(split_threads(6, 50l, 50l), std::make_pair(3, 3));
+    ASSERT_EQ(split_threads(7, 30l, 70l), std::make_pair(2, 5));
+    // every part gets at least one thread
+    ASSERT_EQ(split_threads(4, 1000l, 0l), std::make_pair(3, 1));
+    ASSERT_EQ(split_threads(2, 1l, 1000l), std::make_pair(1, 1));
+    // one thread cannot be split
+    ASSERT_EQ(split_threads(1, 10l, 10l), std::make_pair(1, 1));
+    // no thread is lost
+    for (int threads = 2; threads < 64; ++threads) {
+        for (long l_size = 0; l_size <= 100; l_size += 7) {
+            const auto [l_threads, r_threads] = split_threads(threads, l_size, 100 - l_size);
+            ASSERT_EQ(l_threads + r_threads, threads);
+            ASSERT_GE(l_threads, 1);
+            ASSERT_GE(r_threads, 1);
+        }
+    }
+}
+
+TEST(Concurrency, RepeatedCalls) {
+    std::mt19937 rng(std::random_device{}());
+    std::uniform_int_distribution<int> dist;
+    for (int i = 0; i < 5; ++i) {
+        std::vector<int> in(static_cast<std::size_t>(1e6));
+        std::ranges::generate(in, [&] { return dist(rng); });
+        std::vector<int> ref(in);
+        // alternating number of threads forces the shared pool to be recreated
+        ppqsort::sort(ppqsort::execution::par, in.begin(), in.end(), 2 + i % 2);
+        std::sort(ref.begin(), ref.end());
+        ASSERT_THAT(in, ::testing::ContainerEq(ref));
+    }
+}
+
+TEST(Concurrency, ParallelCallers) {
+    constexpr int callers = 4;
+    std::vector<std::vector<int>> inputs(callers, std::vector<int>(static_cast<std::size_t>(1e6)));
+    std::mt19937 rng(std::random_device{}());
+    std::uniform_int_distribution<int> dist;
+    for (auto & in : inputs)
+        std::ranges::generate(in, [&] { return dist(rng); });
+    auto refs(inputs);
+
+    // only one caller can use the shared pool, others must not wait for it
+    std::vector<std::thread> threads;
+    for (auto & in : inputs)
+        threads.emplace_back([&in] { ppqsort::sort(ppqsort::execution::par, in.begin(), in.end(), 4); });
+    for (auto & t : threads)
+        t.join();
+
+    for (int i = 0; i < callers; ++i) {
+        std::sort(refs[i].begin(), refs[i].end());
+        ASSERT_THAT(inputs[i], ::testing::ContainerEq(refs[i]));
+    }
+}
+
+// fake cgroup filesystem and /proc/self/cgroup
+class Parallelism : public ::testing::Test {
+    protected:
+        void SetUp() override {
+            root_ = std::filesystem::temp_directory_path() /
+                    ("ppqsort_cgroup_" + std::to_string(::testing::UnitTest::GetInstance()->random_seed()));
+            std::filesystem::create_directories(root_);
+        }
+
+        void TearDown() override {
+            std::filesystem::remove_all(root_);
+        }
+
+        void write(const std::filesystem::path& file, const std::string& content) const {
+            std::filesystem::create_directories((root_ / file).parent_path());
+            std::ofstream(root_ / file) << content;
+        }
+
+        [[nodiscard]] int limit() const {
+            return ppqsort::impl::cgroup_cpu_limit((root_ / "cgroup").string(), (root_ / "proc_cgroup").string());
+        }
+
+        std::filesystem::path root_;
+};
+
+TEST_F(Parallelism, NoQuota) {
+    ASSERT_EQ(limit(), 0);
+    write("cgroup/cpu.max", "max 100000\n");
+    ASSERT_EQ(limit(), 0);
+    write("cgroup/cpu/cpu.cfs_quota_us", "-1\n");
+    write("cgroup/cpu/cpu.cfs_period_us", "100000\n");
+    ASSERT_EQ(limit(), 0);
+}
+
+TEST_F(Parallelism, CgroupV2) {
+    write("proc_cgroup", "0::/system.slice/app.service\n");
+    write("cgroup/system.slice/app.service/cpu.max", "400000 100000\n");
+    ASSERT_EQ(limit(), 4);
+    // fractions are rounded up
+    write("cgroup/system.slice/app.service/cpu.max", "250000 100000\n");
+    ASSERT_EQ(limit(), 3);
+    // parent has a lower quota
+    write("cgroup/system.slice/cpu.max", "200000 100000\n");
+    ASSERT_EQ(limit(), 2);
+}
+
+TEST_F(Parallelism, CgroupV1) {
+    write("proc_cgroup", "5:cpuacct,cpu:/docker/abc\n4:memory:/docker/abc\n");
+    write("cgroup/cpu,cpuacct/docker/abc/cpu.cfs_quota_us", "50000\n");
+    write("cgroup/cpu,cpuacct/docker/abc/cpu.cfs_period_us", "100000\n");
+    ASSERT_EQ(limit(), 1);
+    write("cgroup/cpu,cpuacct/docker/abc/cpu.cfs_quota_us", "600000\n");
+    ASSERT_EQ(limit(), 6);
+}
+
+TEST_F(Parallelism, EffectiveParallelism) {
+    const int available = ppqsort::impl::effective_parallelism((root_ / "cgroup").string(),
+                                                               (root_ / "proc_cgroup").string());
+    ASSERT_GE(available, 1);
+    ASSERT_LE(available, static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u)));
+    // quota never increases the parallelism and is never below one thread
+    write("cgroup/cpu.max", "1000 100000\n");
+    ASSERT_EQ(ppqsort::impl::effective_parallelism((root_ / "cgroup").string(), (root_ / "proc_cgroup").string()), 1);
+    write("cgroup/cpu.max", "100000000 100000\n");
+    ASSERT_EQ(ppqsort::impl::effective_parallelism((root_ / "cgroup").string(), (root_ / "proc_cgroup").string()),
+              available);
+}
+
+#ifndef _OPENMP
+TEST(Concurrency, PartitionInsideWorker) {
+    // the only other worker is enough, the calling worker takes part in the partitioning
+    ppqsort::impl::cpp::ThreadPool<> pool(2);
+    std::vector<int> in(static_cast<std::size_t>(1e6));
+    std::mt19937 rng(std::random_device{}());
+    std::ranges::generate(in, [&] { return static_cast<int>(rng() % 1000); });
+    for (int round = 0; round < 2; ++round) {
+        std::pair<std::vector<int>::iterator, bool> res;
+        pool.push_task([&] {
+            res = round ? ppqsort::impl::cpp::partition_to_right_par(in.begin(), in.end(), std::less<>(), 2, pool)
+                        : ppqsort::impl::cpp::partition_right_branchless_par(in.begin(), in.end(), std::less<>(), 2, pool);
+        });
+        pool.wait();
+        const int pivot = *res.first;
+        ASSERT_TRUE(std::is_partitioned(in.begin(), in.end(), [&](const int & i){ return i < pivot; }));
+        std::ranges::shuffle(in, rng);
+    }
+}
+
+TEST(Concurrency, PartitionWithBusyWorker) {
+    // one worker is busy for the whole test, so most of the helpers join late or never
+    ppqsort::impl::cpp::ThreadPool<> pool(2);
+    std::latch busy(1);
+    pool.push_task([&] { busy.wait(); });
+    std::vector<int> in(static_cast<std::size_t>(1e6));
+    std::mt19937 rng(std::random_device{}());
+    std::ranges::generate(in, [&] { return static_cast<int>(rng() % 1000); });
+    for (int round = 0; round < 2; ++round) {
+        std::pair<std::vector<int>::iterator, bool> res;
+        std::latch done(1);
+        pool.push_task([&] {
+            res = round ? ppqsort::impl::cpp::partition_to_right_par(in.begin(), in.end(), std::less<>(), 8, pool)
+                        : ppqsort::impl::cpp::partition_right_branchless_par(in.begin(), in.end(), std::less<>(), 8, pool);
+            done.count_down();
+        });
+        done.wait();
+        const int pivot = *res.first;
+        // the busy worker must be released even on failure
+        EXPECT_TRUE(std::is_partitioned(in.begin(), in.end(), [&](const int & i){ return i < pivot; }));
+        std::ranges::shuffle(in, rng);
+    }
+    busy.count_down();
+    pool.wait();
+}
+
+TEST(Concurrency, PoolWithCaller) {
+    // recursive tasks and partitions share one pool, the caller is the last of the threads
+    constexpr int threads = 4;
+    ppqsort::impl::cpp::ThreadPool<> pool(threads - 1);
+    std::mt19937 rng(std::random_device{}());
+    for (const int modulo : {2, 100, std::numeric_limits<int>::max()}) {
+        std::vector<int> in(static_cast<std::size_t>(2e6));
+        std::ranges::generate(in, [&] { return static_cast<int>(rng() % modulo); });
+        std::vector<int> ref(in);
+        ppqsort::impl::cpp::par_ppqsort(in.begin(), in.end(), std::less<>(), threads, pool);
+        std::sort(ref.begin(), ref.end());
+        ASSERT_THAT(in, ::testing::ContainerEq(ref));
+    }
+}
+
+TEST(Concurrency, NumaPool) {
+    // two fake nodes, tasks are pushed to the node holding the pages
+    constexpr int threads = 6;
+    ppqsort::impl::cpp::ThreadPool<> pool(threads - 1, {}, ppqsort::impl::cpp::WorkersLayout{{}, {0, 0, 1, 1, 1}});
+    std::mt19937 rng(std::random_device{}());
+    std::vector<int> in(static_cast<std::size_t>(4e6));
+    std::ranges::generate(in, [&] { return static_cast<int>(rng()); });
+    std::vector<int> ref(in);
+    ppqsort::impl::cpp::par_ppqsort(in.begin(), in.end(), std::less<>(), threads, pool);
+    std::sort(ref.begin(), ref.end());
+    ASSERT_THAT(in, ::testing::ContainerEq(ref));
+}
+
+TEST(Concurrency, PinnedSharedPool) {
+    using namespace ppqsort::impl::cpp;
+    ThreadPoolLease::configure(WaitPolicy{}, Placement::compact());
+    std::vector<int> in(static_cast<std::size_t>(2e6));
+    std::mt19937 rng(std::random_device{}());
+    std::ranges::generate(in, [&] { return static_cast<int>(rng()); });
+    std::vector<int> ref(in);
+    ppqsort::sort(ppqsort::execution::par, in.begin(), in.end(), 4);
+    ThreadPoolLease::configure(WaitPolicy{});
+    std::sort(ref.begin(), ref.end());
+    ASSERT_THAT(in, ::testing::ContainerEq(ref));
+}
+#endif
+
 // Random to test general cases, different types and ranges
 TYPED_TEST_SUITE_P(RandomVectorFixture);
 
@@ -263,7 +916,28 @@ TYPED_TEST_P(RandomVectorFixture, Ranges) {
     }
 }
 
-REGISTER_TYPED_TEST_SUITE_P(RandomVectorFixture, FullTypeRange, CustomComparator, Ranges, Threads);
+TYPED_TEST_P(RandomVectorFixture, Radix) {
+    if constexpr (ppqsort::impl::radix_sortable<TypeParam, std::less<TypeParam>>) {
+        for (auto const & size: sizes) {
+            for (int threadCount = 1; threadCount <= 4; ++threadCount) {
+                this->AllocateVector(size);
+                this->FillVector();
+                auto ref(this->data);
+                ppqsort::sort(ppqsort::execution::par_radix, this->data.begin(), this->data.end(), threadCount*2);
+                std::sort(ref.begin(), ref.end());
+                ASSERT_THAT(this->data, ::testing::ContainerEq(ref));
+            }
+            this->AllocateVector(size);
+            this->FillVector(ranges[3]);
+            auto ref(this->data);
+            ppqsort::sort(ppqsort::execution::par_radix, this->data.begin(), this->data.end(), std::greater<>());
+            std::sort(ref.begin(), ref.end(), std::greater<>());
+            ASSERT_THAT(this->data, ::testing::ContainerEq(ref));
+        }
+    }
+}
+
+REGISTER_TYPED_TEST_SUITE_P(RandomVectorFixture, FullTypeRange, CustomComparator, Ranges, Threads, Radix);
 using baseTypesUnsigned = ::testing::Types<unsigned char, unsigned short, unsigned int, unsigned long, unsigned long long>;
 using baseTypes = ::testing::Types<char, short, int, long, long long, float, double, long double>;
 INSTANTIATE_TYPED_TEST_SUITE_P(UnsignedTypes, RandomVectorFixture, baseTypesUnsigned);
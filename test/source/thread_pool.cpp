@@ -5,8 +5,17 @@
  ****************************************************/
 
 #include <gtest/gtest.h>
+#include <array>
+#include <filesystem>
+#include <fstream>
 #include <future>
+#include <latch>
+#include <memory>
+#include "ppqsort/parallel/cpp/affinity.h"
+#include "ppqsort/parallel/cpp/inplace_task.h"
+#include "ppqsort/parallel/cpp/numa.h"
 #include "ppqsort/parallel/cpp/thread_pool.h"
+#include "ppqsort/parallel/cpp/work_stealing_deque.h"
 
 namespace ppqsort::impl::cpp {
     TEST(testThreadPool, TryPushConcurrent) {
@@ -49,6 +58,30 @@ namespace ppqsort::impl::cpp {
         ASSERT_EQ(counter, 1000);
     }
 
+    TEST(testThreadPool, WaitAndReuse) {
+        ThreadPool pool(2);
+        std::atomic<int> counter = 0;
+
+        // pool must stay usable after wait, tasks can spawn another tasks
+        for (int round = 1; round <= 3; ++round) {
+            for (int i = 0; i < 100; ++i) {
+                pool.push_task([&]() {
+                    ++counter;
+                    pool.push_task([&]() { ++counter; });
+                });
+            }
+            pool.wait();
+            ASSERT_EQ(counter, round * 200);
+        }
+        pool.wait_and_stop();
+    }
+
+    TEST(testThreadPool, WaitEmpty) {
+        ThreadPool pool(2);
+        pool.wait();
+        pool.wait();
+    }
+
     TEST(testThreadPool, StopEmpty) {
         using namespace ppqsort::impl::cpp;
         ThreadPool pool;
@@ -56,7 +89,8 @@ namespace ppqsort::impl::cpp {
 
     TEST(testThreadPool, PrematureExit) {
         using namespace ppqsort::impl::cpp;
-        ThreadPool<> testPool(2);
+        // the waiting thread helps too, so there are two threads
+        ThreadPool<> testPool(1);
 
         std::thread::id id_task_1, id_end;
 
@@ -91,8 +125,9 @@ namespace ppqsort::impl::cpp {
         ThreadPool pool(2);
         std::atomic<int> counter{0};
 
-        pool.threads_queues_[0].mutex_.lock();
-        pool.threads_queues_[1].mutex_.lock();
+        // queue of the caller too
+        for (auto& queue : pool.threads_queues_)
+            queue.mutex_.lock();
 
         std::jthread t1([&](){
             // try to push, should fallback to waiting for the first queue
@@ -101,8 +136,8 @@ namespace ppqsort::impl::cpp {
 
         // simulate busy queues for some time
         std::this_thread::sleep_for(std::chrono::milliseconds(5000));
-        pool.threads_queues_[0].mutex_.unlock();
-        pool.threads_queues_[1].mutex_.unlock();
+        for (auto& queue : pool.threads_queues_)
+            queue.mutex_.unlock();
         pool.wait_and_stop();
 
         ASSERT_EQ(counter, 1);
@@ -119,8 +154,8 @@ namespace ppqsort::impl::cpp {
         pool.pending_tasks_ = 2;
 
         // lock all queues
-        pool.threads_queues_[0].mutex_.lock();
-        pool.threads_queues_[1].mutex_.lock();
+        for (auto& queue : pool.threads_queues_)
+            queue.mutex_.lock();
 
 
         std::jthread t1([&](){
@@ -130,14 +165,451 @@ namespace ppqsort::impl::cpp {
 
         // simulate busy queues for some time
         std::this_thread::sleep_for(std::chrono::milliseconds(5000));
-        pool.threads_queues_[0].mutex_.unlock();
-        pool.threads_queues_[1].mutex_.unlock();
+        for (auto& queue : pool.threads_queues_)
+            queue.mutex_.unlock();
 
         pool.wait_and_stop();
         ASSERT_EQ(counter, 3);
     }
 
 
+    TEST(testThreadPool, WorkerPushesToOwnDeque) {
+        ThreadPool pool(1);
+        std::atomic<int> counter{0};
+        std::size_t deque_size = 0;
+        std::latch pushed(1);
+
+        pool.push_task([&]() {
+            pool.push_task([&]() { ++counter; });
+            // the only worker is busy and we do not help yet, so the child task must be still in its deque
+            deque_size = pool.threads_deques_[0].size();
+            ++counter;
+            pushed.count_down();
+        });
+        pushed.wait();
+        pool.wait_and_stop();
+
+        ASSERT_EQ(counter, 2);
+        ASSERT_EQ(deque_size, 1);
+    }
+
+    TEST(testThreadPool, RecursiveTasks) {
+        ThreadPool pool(4);
+        std::atomic<int> counter{0};
+
+        // binary tree of tasks, similar to recursion in quicksort
+        std::function<void(int)> spawn = [&](const int depth) {
+            ++counter;
+            if (depth == 0)
+                return;
+            pool.push_task([&, depth]() { spawn(depth - 1); });
+            spawn(depth - 1);
+        };
+        pool.push_task([&]() { spawn(12); });
+        pool.wait_and_stop();
+
+        ASSERT_EQ(counter, (1 << 13) - 1);
+    }
+
+
+    TEST(testThreadPool, RecycleTaskSlots) {
+        // no workers, the caller runs everything, so the number of tasks in flight is deterministic
+        ThreadPool pool(0);
+        std::atomic<int> counter{0};
+
+        std::function<void(int)> spawn = [&](const int depth) {
+            ++counter;
+            if (depth == 0)
+                return;
+            pool.push_task([&, depth]() { spawn(depth - 1); });
+            spawn(depth - 1);
+        };
+
+        // the second run must reuse slots from the first run
+        pool.run_and_wait([&]() { spawn(10); });
+        const std::size_t slots = pool.slot_caches_[0].slots.size();
+        pool.run_and_wait([&]() { spawn(10); });
+        pool.wait_and_stop();
+
+        ASSERT_EQ(counter, 2 * ((1 << 11) - 1));
+        ASSERT_GT(slots, 0);
+        ASSERT_EQ(pool.slot_caches_[0].slots.size(), slots);
+    }
+
+    TEST(testThreadPool, CallerHelps) {
+        ThreadPool pool(1);
+        std::atomic<bool> release{false};
+        std::atomic<int> counter{0};
+        std::atomic<int> by_caller{0};
+        const auto caller_id = std::this_thread::get_id();
+
+        // block the only worker, the caller must execute the rest while waiting
+        pool.push_task([&]() {
+            while (!release.load())
+                std::this_thread::yield();
+        });
+        while (pool.pending_tasks_.load() > 0)
+            std::this_thread::yield();
+
+        pool.run_and_wait([&]() {
+            for (int i = 0; i < 100; ++i) {
+                pool.push_task([&]() {
+                    by_caller += std::this_thread::get_id() == caller_id;
+                    if (++counter == 100)
+                        release.store(true);
+                });
+            }
+        });
+        pool.wait_and_stop();
+
+        ASSERT_EQ(by_caller, 100);
+    }
+
+    TEST(testThreadPool, HelpUntilRunsOwnTasks) {
+        ThreadPool pool(0);
+        int counter = 0;
+        std::latch done(3);
+
+        pool.run_and_wait([&]() {
+            const std::int64_t mark = pool.mark();
+            for (int i = 0; i < 3; ++i)
+                pool.push_task([&]() { ++counter; done.count_down(); });
+            // nobody else can run them
+            pool.help_until(done, mark);
+            ASSERT_EQ(counter, 3);
+        });
+        pool.wait_and_stop();
+    }
+
+
+    TEST(testThreadPool, WakeOne) {
+        constexpr int workers = 4;
+        ThreadPool pool(workers, WaitPolicy{0, 0, true});
+        std::atomic<int> counter{0};
+
+        // wait until all workers sleep, atomic wait can spin for a while before it blocks in the kernel
+        while (pool.sleepers_.load() < workers)
+            std::this_thread::yield();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        pool.reset_metrics();
+
+        // one task must wake only one worker
+        pool.push_task([&]() { ++counter; });
+        while (pool.metrics().wakeups == 0)
+            std::this_thread::yield();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        const ThreadPoolMetrics metrics = pool.metrics();
+        pool.wait_and_stop();
+
+        ASSERT_EQ(counter, 1);
+        ASSERT_EQ(metrics.notifications, 1);
+        ASSERT_LT(metrics.wakeups, workers);
+    }
+
+    TEST(testThreadPool, NoParking) {
+        ThreadPool pool(2, WaitPolicy{16, 1, false});
+        std::atomic<int> counter{0};
+
+        for (int round = 0; round < 10; ++round) {
+            for (int i = 0; i < 100; ++i)
+                pool.push_task([&]() { ++counter; });
+            pool.wait();
+        }
+        const ThreadPoolMetrics metrics = pool.metrics();
+        pool.wait_and_stop();
+
+        ASSERT_EQ(counter, 1000);
+        ASSERT_EQ(metrics.parks, 0);
+        ASSERT_EQ(metrics.wakeups, 0);
+        ASSERT_EQ(metrics.notifications, 0);
+    }
+
+
+    /****************************************************
+     * InplaceTask Tests
+    ****************************************************/
+
+    TEST(testInplaceTask, SmallCallableInplace) {
+        int counter = 0;
+        int* a = &counter;
+        int* b = &counter;
+        auto callable = [a, b, &counter]() { counter += (a == b) ? 1 : 0; };
+        static_assert(InplaceTask<>::fits_inplace<decltype(callable)>);
+
+        InplaceTask<> task(callable);
+        ASSERT_TRUE(task);
+        task();
+        task();
+        ASSERT_EQ(counter, 2);
+    }
+
+    TEST(testInplaceTask, LargeCallableOnHeap) {
+        std::array<int, 256> data{};
+        data.back() = 42;
+        int result = 0;
+        auto callable = [data, &result]() { result = data.back(); };
+        static_assert(!InplaceTask<>::fits_inplace<decltype(callable)>);
+
+        InplaceTask<> task(callable);
+        InplaceTask<> moved(std::move(task));
+        ASSERT_FALSE(task);
+        moved();
+        ASSERT_EQ(result, 42);
+    }
+
+    TEST(testInplaceTask, MoveAndDestroyCaptures) {
+        auto shared = std::make_shared<int>(1);
+        InplaceTask<> task([shared]() { ++*shared; });
+        ASSERT_EQ(shared.use_count(), 2);
+
+        InplaceTask<> other;
+        other = std::move(task);
+        ASSERT_FALSE(task);
+        ASSERT_EQ(shared.use_count(), 2);
+        other();
+        ASSERT_EQ(*shared, 2);
+
+        other.reset();
+        ASSERT_FALSE(other);
+        ASSERT_EQ(shared.use_count(), 1);
+    }
+
+
+    /****************************************************
+     * WorkStealingDeque Tests
+    ****************************************************/
+
+    TEST(testWorkStealingDeque, PushPop) {
+        WorkStealingDeque<int> deque;
+        deque.push(1);
+        deque.push(2);
+        deque.push(3);
+        ASSERT_EQ(deque.size(), 3);
+        ASSERT_EQ(deque.pop().value(), 3);
+        ASSERT_EQ(deque.pop().value(), 2);
+        ASSERT_EQ(deque.pop().value(), 1);
+        ASSERT_FALSE(deque.pop().has_value());
+        ASSERT_TRUE(deque.empty());
+    }
+
+    TEST(testWorkStealingDeque, Steal) {
+        WorkStealingDeque<int> deque;
+        ASSERT_FALSE(deque.steal().has_value());
+        deque.push(1);
+        deque.push(2);
+        deque.push(3);
+        ASSERT_EQ(deque.steal().value(), 1);
+        ASSERT_EQ(deque.pop().value(), 3);
+        ASSERT_EQ(deque.steal().value(), 2);
+        ASSERT_FALSE(deque.steal().has_value());
+        ASSERT_FALSE(deque.pop().has_value());
+    }
+
+    TEST(testWorkStealingDeque, Grow) {
+        WorkStealingDeque<int> deque(4);
+        for (int i = 0; i < 1000; ++i)
+            deque.push(i);
+        ASSERT_GT(deque.buffers_.size(), 1);
+        ASSERT_EQ(deque.size(), 1000);
+        for (int i = 0; i < 500; ++i)
+            ASSERT_EQ(deque.steal().value(), i);
+        for (int i = 999; i >= 500; --i)
+            ASSERT_EQ(deque.pop().value(), i);
+        ASSERT_TRUE(deque.empty());
+    }
+
+    TEST(testWorkStealingDeque, ConcurrentSteal) {
+        constexpr int items = 200000;
+        constexpr int thieves = 3;
+        WorkStealingDeque<int> deque(2);
+        std::vector<std::atomic<int>> taken(items);
+        std::atomic<bool> done{false};
+
+        std::vector<std::jthread> threads;
+        for (int i = 0; i < thieves; ++i) {
+            threads.emplace_back([&]() {
+                while (!done.load(std::memory_order_acquire) || !deque.empty()) {
+                    if (auto item = deque.steal())
+                        ++taken[item.value()];
+                }
+            });
+        }
+
+        // owner pushes and from time to time pops, thieves steal concurrently
+        for (int i = 0; i < items; ++i) {
+            deque.push(i);
+            if (i % 3 == 0) {
+                if (auto item = deque.pop())
+                    ++taken[item.value()];
+            }
+        }
+        while (auto item = deque.pop())
+            ++taken[item.value()];
+        done.store(true, std::memory_order_release);
+        threads.clear();
+
+        // each item must be taken exactly once
+        for (int i = 0; i < items; ++i)
+            ASSERT_EQ(taken[i], 1);
+    }
+
+
+    /****************************************************
+     * Affinity Tests
+    ****************************************************/
+
+    // 2 packages x 2 cores x 2 SMT threads, numbered like Linux does: first threads of all cores, then siblings
+    class testAffinity : public ::testing::Test {
+        protected:
+            void SetUp() override {
+                root_ = std::filesystem::temp_directory_path() /
+                        ("ppqsort_sysfs_" + std::to_string(::testing::UnitTest::GetInstance()->random_seed()));
+                for (int cpu = 0; cpu < 8; ++cpu) {
+                    const auto dir = root_ / ("cpu" + std::to_string(cpu)) / "topology";
+                    std::filesystem::create_directories(dir);
+                    std::ofstream(dir / "core_id") << (cpu % 2) << "\n";
+                    std::ofstream(dir / "physical_package_id") << (cpu % 4) / 2 << "\n";
+                }
+            }
+
+            void TearDown() override {
+                std::filesystem::remove_all(root_);
+            }
+
+            std::filesystem::path root_;
+    };
+
+    TEST_F(testAffinity, ReadTopology) {
+        const auto topology = read_cpu_topology({1, 6}, root_.string());
+        ASSERT_EQ(topology.size(), 2);
+        ASSERT_EQ(topology[0].cpu, 1);
+        ASSERT_EQ(topology[0].core, 1);
+        ASSERT_EQ(topology[0].package, 0);
+        ASSERT_EQ(topology[1].cpu, 6);
+        ASSERT_EQ(topology[1].core, 0);
+        ASSERT_EQ(topology[1].package, 1);
+    }
+
+    TEST_F(testAffinity, SpreadPhysicalCoresFirst) {
+        const auto topology = read_cpu_topology({0, 1, 2, 3, 4, 5, 6, 7}, root_.string());
+        const std::vector<int> expected{0, 1, 2, 3, 4, 5, 6, 7};
+        ASSERT_EQ(placement_order(topology, Placement::Mode::spread), expected);
+    }
+
+    TEST_F(testAffinity, CompactSiblingsTogether) {
+        const auto topology = read_cpu_topology({0, 1, 2, 3, 4, 5, 6, 7}, root_.string());
+        const std::vector<int> expected{0, 4, 1, 5, 2, 6, 3, 7};
+        ASSERT_EQ(placement_order(topology, Placement::Mode::compact), expected);
+    }
+
+    TEST_F(testAffinity, MissingTopology) {
+        // each CPU without topology is a separate core, CPUs are ordered by their ids
+        const auto topology = read_cpu_topology({3, 1, 2}, (root_ / "missing").string());
+        const std::vector<int> expected{1, 2, 3};
+        ASSERT_EQ(placement_order(topology, Placement::Mode::spread), expected);
+        ASSERT_EQ(placement_order(topology, Placement::Mode::compact), expected);
+        ASSERT_EQ(placement_order(topology, Placement::Mode::none), std::vector<int>({3, 1, 2}));
+    }
+
+    TEST_F(testAffinity, ParseCpuList) {
+        ASSERT_EQ(parse_cpu_list("0-3,8,10-11\n"), std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+        ASSERT_EQ(parse_cpu_list("5"), std::vector<int>({5}));
+        ASSERT_TRUE(parse_cpu_list("").empty());
+    }
+
+    TEST_F(testAffinity, ReadNumaTopology) {
+        const auto nodes_root = root_ / "node";
+        const auto write = [&](const std::string& node, const std::string& cpulist) {
+            std::filesystem::create_directories(nodes_root / node);
+            std::ofstream(nodes_root / node / "cpulist") << cpulist << "\n";
+        };
+        write("node1", "4-7");
+        write("node0", "0-3");
+        // memory-only node
+        write("node2", "");
+        std::filesystem::create_directories(nodes_root / "power");
+
+        const auto nodes = read_numa_topology(nodes_root.string());
+        ASSERT_EQ(nodes.size(), 2);
+        ASSERT_EQ(nodes[0].id, 0);
+        ASSERT_EQ(nodes[0].cpus, std::vector<int>({0, 1, 2, 3}));
+        ASSERT_EQ(nodes[1].id, 1);
+        ASSERT_EQ(nodes[1].cpus, std::vector<int>({4, 5, 6, 7}));
+        ASSERT_TRUE(read_numa_topology((root_ / "missing").string()).empty());
+    }
+
+    TEST_F(testAffinity, NumaLayout) {
+        // node 0 has CPUs 0, 1, 4, 5 (cores 0, 1 of the first package), node 1 the rest
+        const std::vector<NumaNode> nodes{{0, {0, 1, 4, 5}}, {1, {2, 3, 6, 7}}};
+        const auto layout = numa_layout(nodes, 6, root_.string());
+        // workers are split evenly, physical cores of the node are used first
+        ASSERT_EQ(layout.nodes, std::vector<int>({0, 0, 0, 1, 1, 1}));
+        ASSERT_EQ(layout.cpus, std::vector<int>({0, 1, 4, 2, 3, 6}));
+    }
+
+    TEST(testThreadPool, MemoryNode) {
+        std::vector<int> data(1 << 20, 1);
+        const int node = memory_node(data.data(), data.data() + data.size());
+        // the query can be forbidden in containers
+        ASSERT_GE(node, -1);
+        ASSERT_EQ(memory_node(data.data(), data.data()), -1);
+    }
+
+    TEST(testThreadPool, NumaStealOrder) {
+        // workers 0, 1 on node 0 and 2, 3 on node 1, the caller has id 4
+        ThreadPool pool(4, {}, WorkersLayout{{}, {0, 0, 1, 1}});
+        ASSERT_TRUE(pool.numa_);
+        ASSERT_EQ(pool.steal_orders_[0], std::vector<unsigned int>({1, 2, 3, 4}));
+        ASSERT_EQ(pool.steal_orders_[2], std::vector<unsigned int>({3, 4, 0, 1}));
+        ASSERT_EQ(pool.steal_orders_[3], std::vector<unsigned int>({2, 4, 0, 1}));
+        ASSERT_EQ(pool.steal_orders_[4], std::vector<unsigned int>({0, 1, 2, 3}));
+        pool.wait_and_stop();
+    }
+
+    TEST(testThreadPool, PushToNode) {
+        ThreadPool pool(4, {}, WorkersLayout{{}, {0, 0, 1, 1}});
+        std::atomic<int> counter{0};
+        pool.run_and_wait([&] {
+            for (int i = 0; i < 1000; ++i)
+                pool.push_task([&] { ++counter; }, i % 3 - 1);
+        });
+        for (int i = 0; i < 1000; ++i)
+            pool.push_task([&] { ++counter; }, i % 2);
+        pool.wait_and_stop();
+        ASSERT_EQ(counter, 2000);
+    }
+
+    TEST(testThreadPool, PinnedWorkers) {
+        const auto allowed = allowed_cpus();
+        if (allowed.empty())
+            GTEST_SKIP() << "Affinity is not supported";
+
+        ThreadPool pool(3, {}, Placement::pinned({allowed.front()}));
+        ASSERT_EQ(pool.workers_cpus(), std::vector<int>({allowed.front()}));
+
+        std::atomic<int> pinned{0};
+        std::latch all_started(3);
+        for (int i = 0; i < 3; ++i) {
+            pool.push_task([&] {
+                // block the worker, so each task runs on a different one
+                all_started.arrive_and_wait();
+                if (allowed_cpus() == std::vector<int>({allowed.front()}))
+                    ++pinned;
+            });
+        }
+        pool.wait_and_stop();
+        ASSERT_EQ(pinned, 3);
+    }
+
+    TEST(testThreadPool, SpreadWorkers) {
+        ThreadPool pool(2, {}, Placement::spread());
+        const auto allowed = allowed_cpus();
+        auto cpus = pool.workers_cpus();
+        std::sort(cpus.begin(), cpus.end());
+        ASSERT_EQ(cpus, allowed);
+    }
+
+
     /****************************************************
      * TaskStack Tests
     ****************************************************/